@@ -0,0 +1,137 @@
+#ifndef BLOOM_MIP_CHAIN_H
+#define BLOOM_MIP_CHAIN_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+// Bloom blur over a chain of progressively halved targets (Jimenez, "Next Generation Post Processing in Call of Duty:
+// Advanced Warfare", 2014). The bright pass is downsampled level by level with a 13 tap filter, then every level is
+// upsampled with a 3x3 tent filter and added onto the one above it. The result is a wide blur at half resolution, for
+// far less fill rate than repeated full resolution Gaussian passes. The levels sum up, so a uniformly bright area comes
+// out about Levels() times as bright as it went in; the composite should scale the bloom by intensity / Levels().
+class BloomMipChain
+{
+public:
+    // downsample and upsample are the bloom_downsample.fs and bloom_upsample.fs programs, both with blur.vs
+    BloomMipChain(Shader &downsample, Shader &upsample, unsigned int width, unsigned int height, unsigned int levels)
+        : downsample(downsample), upsample(upsample), levelCount(levels)
+    {
+        downsample.use();
+        downsample.setInt("image", 0);
+        upsample.use();
+        upsample.setInt("image", 0);
+        filterRadiusUniform = upsample.uniform("filterRadius");
+
+        glGenFramebuffers(1, &fbo);
+        Resize(width, height);
+    }
+
+    ~BloomMipChain()
+    {
+        for (const Level &level : levels)
+            glDeleteTextures(1, &level.texture);
+        glDeleteFramebuffers(1, &fbo);
+    }
+
+    BloomMipChain(const BloomMipChain &) = delete;
+    BloomMipChain &operator=(const BloomMipChain &) = delete;
+
+    // recreates the levels for a bright pass of width x height, if that isn't the size they have
+    void Resize(unsigned int width, unsigned int height)
+    {
+        if (width == this->width && height == this->height)
+            return;
+        this->width = width;
+        this->height = height;
+        for (const Level &level : levels)
+            glDeleteTextures(1, &level.texture);
+        levels.clear();
+        for (unsigned int i = 0; i < levelCount; i++)
+        {
+            Level level;
+            level.width = std::max(1u, width >> (i + 1));
+            level.height = std::max(1u, height >> (i + 1));
+            glGenTextures(1, &level.texture);
+            glBindTexture(GL_TEXTURE_2D, level.texture);
+            // the bloom needs no alpha and little precision, the packed float format halves the bandwidth of RGBA16F
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, level.width, level.height, 0, GL_RGB, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            levels.push_back(level);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    unsigned int Levels() const
+    {
+        return levels.size();
+    }
+
+    // blurs source (the bright pass) and returns the texture holding the bloom. radius is the upsampling filter's
+    // reach as a fraction of the screen height, larger values give a wider, softer bloom. drawQuad draws a screen
+    // filling quad. leaves the default framebuffer bound, the viewport and blending are restored.
+    unsigned int Render(unsigned int source, float radius, void (*drawQuad)())
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLboolean blend = glIsEnabled(GL_BLEND);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glActiveTexture(GL_TEXTURE0);
+
+        // downsample: every level from the one above it
+        glDisable(GL_BLEND);
+        downsample.use();
+        for (unsigned int i = 0; i < levels.size(); i++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, levels[i].texture, 0);
+            glViewport(0, 0, levels[i].width, levels[i].height);
+            glBindTexture(GL_TEXTURE_2D, i == 0 ? source : levels[i - 1].texture);
+            drawQuad();
+        }
+
+        // upsample: every level added onto the one above it, from the smallest up
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glBlendEquation(GL_FUNC_ADD);
+        upsample.use();
+        float aspect = levels.empty() ? 1.0f : (float) levels[0].width / levels[0].height;
+        upsample.setVec2(filterRadiusUniform, glm::vec2(radius / aspect, radius));
+        for (unsigned int i = levels.size() - 1; i > 0; i--)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, levels[i - 1].texture, 0);
+            glViewport(0, 0, levels[i - 1].width, levels[i - 1].height);
+            glBindTexture(GL_TEXTURE_2D, levels[i].texture);
+            drawQuad();
+        }
+
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        if (!blend)
+            glDisable(GL_BLEND);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        return levels.empty() ? source : levels[0].texture;
+    }
+
+private:
+    struct Level {
+        unsigned int texture;
+        unsigned int width, height;
+    };
+
+    Shader &downsample, &upsample;
+    UniformLocation filterRadiusUniform;
+    unsigned int fbo = 0;
+    unsigned int levelCount;
+    unsigned int width = 0, height = 0;    // of the bright pass
+    vector<Level> levels;
+};
+#endif
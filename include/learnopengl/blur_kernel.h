@@ -0,0 +1,77 @@
+#ifndef BLUR_KERNEL_H
+#define BLUR_KERNEL_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// widest kernel the blurs take, in texels on either side of the center. blur.fs's MAX_BLUR_TAPS has to hold
+// BLUR_MAX_RADIUS / 2 + 1 taps, and blur.cs keeps a tile with an apron of BLUR_MAX_RADIUS in shared memory.
+const unsigned int BLUR_MAX_RADIUS = 16;
+
+// One direction of a separable Gaussian blur with linear sampling (Rákos, "Efficient Gaussian blur with linear
+// sampling", 2010): two neighbouring texels are read with a single bilinear fetch between them, placed so the filter
+// weighs them as the kernel does. A kernel of radius r then takes r / 2 + 1 fetches per direction instead of r + 1.
+// weights[0] and offsets[0] are the center tap, the others are used on both sides of it. The compute blur reads texels
+// from shared memory, where filtering doesn't help; it takes texelWeights, one per texel from the center out.
+struct BlurKernel {
+    vector<float> weights;
+    vector<float> offsets;  // in texels
+    vector<float> texelWeights;
+    unsigned int radius = 0;
+    float sigma = 0.0f;
+};
+
+// the Gaussian of the given sigma over radius texels on either side, normalized to sum to one, with its taps merged
+// into linear fetches. radius is clamped to BLUR_MAX_RADIUS.
+BlurKernel GaussianBlurKernel(float sigma, unsigned int radius)
+{
+    BlurKernel kernel;
+    kernel.radius = std::min(std::max(radius, 1u), BLUR_MAX_RADIUS);
+    kernel.sigma = std::max(sigma, 0.01f);
+
+    vector<float> texels(kernel.radius + 1);
+    float sum = 0.0f;
+    for (unsigned int i = 0; i <= kernel.radius; i++)
+    {
+        texels[i] = std::exp(-(float) (i * i) / (2.0f * kernel.sigma * kernel.sigma));
+        sum += i == 0 ? texels[i] : 2.0f * texels[i];
+    }
+    for (float &weight : texels)
+        weight /= sum;
+    kernel.texelWeights = texels;
+
+    kernel.weights.push_back(texels[0]);
+    kernel.offsets.push_back(0.0f);
+    for (unsigned int i = 1; i <= kernel.radius; i += 2)
+    {
+        // an odd radius leaves the outermost texel alone, it is fetched at its center
+        float second = i + 1 <= kernel.radius ? texels[i + 1] : 0.0f;
+        float weight = texels[i] + second;
+        kernel.weights.push_back(weight);
+        kernel.offsets.push_back((i * texels[i] + (i + 1) * second) / weight);
+    }
+    return kernel;
+}
+
+// the kernel a bloom radius in texels gets: the Gaussian falls to about 2% at the radius
+BlurKernel BloomBlurKernel(unsigned int radius)
+{
+    return GaussianBlurKernel(radius / 2.0f, radius);
+}
+
+// uploads a kernel into blur.fs or blur.cs, which has to be in use
+void SetBlurKernel(const Shader &shader, const BlurKernel &kernel)
+{
+    shader.setInt("tapCount", (int) kernel.weights.size());
+    glUniform1fv(shader.uniform("weights").location, (GLsizei) kernel.weights.size(), kernel.weights.data());
+    glUniform1fv(shader.uniform("offsets").location, (GLsizei) kernel.offsets.size(), kernel.offsets.data());
+    shader.setInt("radius", (int) kernel.radius);
+    glUniform1fv(shader.uniform("texelWeights").location, (GLsizei) kernel.texelWeights.size(), kernel.texelWeights.data());
+}
+#endif
@@ -0,0 +1,126 @@
+#ifndef COMPUTE_BLUR_H
+#define COMPUTE_BLUR_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+// Gaussian blur in a compute shader (GL 4.3), the alternative to PingPongBlur on contexts that have one. The loader in
+// libs/glad only covers GL 3.3, so the entry points are loaded here by hand, like the ones of indirect_draw.h.
+
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+
+typedef void (APIENTRYP ComputeDispatchProc)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+typedef void (APIENTRYP ComputeMemoryBarrierProc)(GLbitfield barriers);
+typedef void (APIENTRYP ComputeBindImageTextureProc)(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+                                                     GLint layer, GLenum access, GLenum format);
+
+struct ComputeFunctions {
+    ComputeDispatchProc dispatchCompute = nullptr;
+    ComputeMemoryBarrierProc memoryBarrier = nullptr;
+    ComputeBindImageTextureProc bindImageTexture = nullptr;
+};
+
+ComputeFunctions &ComputeBlurFunctions()
+{
+    static ComputeFunctions functions;
+    return functions;
+}
+
+// loads the compute entry points if the current context has them, call once after gladLoadGLLoader. returns whether
+// the compute blur is available.
+bool LoadComputeBlur(GLADloadproc load)
+{
+    ComputeFunctions &functions = ComputeBlurFunctions();
+    if (GLVersion.major * 10 + GLVersion.minor < 43)
+        return false;
+    functions.dispatchCompute = (ComputeDispatchProc) load("glDispatchCompute");
+    functions.memoryBarrier = (ComputeMemoryBarrierProc) load("glMemoryBarrier");
+    functions.bindImageTexture = (ComputeBindImageTextureProc) load("glBindImageTexture");
+    return functions.dispatchCompute && functions.memoryBarrier && functions.bindImageTexture;
+}
+
+bool ComputeBlurSupported()
+{
+    const ComputeFunctions &functions = ComputeBlurFunctions();
+    return functions.dispatchCompute && functions.memoryBarrier && functions.bindImageTexture;
+}
+
+// texels per side of the square a work group of blur.cs writes, its local size
+const unsigned int COMPUTE_BLUR_TILE = 16;
+
+// Every work group of blur.cs reads its tile and the apron around it into shared memory once, blurs the rows and then
+// the columns from there, and writes the result with imageStore: an iteration is one dispatch, with no rasterization
+// and no framebuffer switches. Iterations alternate between two images; the kernel is whatever SetBlurKernel last
+// gave the shader.
+class ComputeBlur
+{
+public:
+    // shader is blur.cs
+    ComputeBlur(Shader &shader, unsigned int width, unsigned int height)
+        : shader(shader)
+    {
+        shader.use();
+        shader.setInt("image", 0);
+        glGenTextures(2, textures);
+        Resize(width, height);
+    }
+
+    ~ComputeBlur()
+    {
+        glDeleteTextures(2, textures);
+    }
+
+    ComputeBlur(const ComputeBlur &) = delete;
+    ComputeBlur &operator=(const ComputeBlur &) = delete;
+
+    // resizes the images to width x height, the size of the source
+    void Resize(unsigned int width, unsigned int height)
+    {
+        this->width = width;
+        this->height = height;
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // blurs source (the size of the blur) over the given number of iterations, each a horizontal and a vertical pass,
+    // and returns the texture holding the result
+    unsigned int Render(unsigned int source, unsigned int iterations)
+    {
+        const ComputeFunctions &functions = ComputeBlurFunctions();
+        shader.use();
+        glActiveTexture(GL_TEXTURE0);
+        unsigned int result = source;
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, result);
+            result = textures[i % 2];
+            functions.bindImageTexture(0, result, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+            functions.dispatchCompute((width + COMPUTE_BLUR_TILE - 1) / COMPUTE_BLUR_TILE,
+                                      (height + COMPUTE_BLUR_TILE - 1) / COMPUTE_BLUR_TILE, 1);
+            // the next iteration and the composite read the image as a texture, and the one after writes the image
+            // this one read
+            functions.memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        return result;
+    }
+
+private:
+    Shader &shader;
+    unsigned int width, height;
+    unsigned int textures[2];
+};
+#endif
@@ -0,0 +1,61 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <algorithm>
+#include <cmath>
+
+// scales are multiples of this, so small swings in the frame time don't reallocate the render targets every time
+const float DYNAMIC_RESOLUTION_STEP = 0.05f;
+// frames of GPU time the controller averages after a change before it judges the new scale, the timer results lag
+// a few frames behind
+const unsigned int DYNAMIC_RESOLUTION_SETTLE_FRAMES = 30;
+// the scale only grows again once a frame takes less than this share of the budget, so it doesn't flip back and forth
+const float DYNAMIC_RESOLUTION_HEADROOM = 0.8f;
+
+// Picks the scale of the scene's render targets against the window from the measured GPU frame time. A frame over
+// the budget lowers the scale right away by as much as it takes to fit, assuming GPU time follows the pixel count;
+// a frame well under it raises the scale one step at a time.
+class DynamicResolution
+{
+public:
+    DynamicResolution(float budgetMilliseconds, float minScale, float maxScale = 1.0f)
+        : budget(budgetMilliseconds)
+    {
+        minSteps = std::max(1, (int) std::ceil(minScale / DYNAMIC_RESOLUTION_STEP - 0.001f));
+        maxSteps = std::max(minSteps, (int) std::floor(maxScale / DYNAMIC_RESOLUTION_STEP + 0.001f));
+        steps = maxSteps;
+    }
+
+    float Scale() const
+    {
+        return steps * DYNAMIC_RESOLUTION_STEP;
+    }
+
+    // takes in the GPU time of a frame, in milliseconds
+    void Update(double gpuMilliseconds)
+    {
+        average = samples == 0 ? gpuMilliseconds : 0.9 * average + 0.1 * gpuMilliseconds;
+        if (++samples < DYNAMIC_RESOLUTION_SETTLE_FRAMES)
+            return;
+
+        int target = steps;
+        if (average > budget)
+            target = std::min(steps - 1, (int) std::floor(Scale() * std::sqrt(budget / average) / DYNAMIC_RESOLUTION_STEP));
+        else if (average < budget * DYNAMIC_RESOLUTION_HEADROOM)
+            target = steps + 1;
+        target = std::min(std::max(target, minSteps), maxSteps);
+        if (target != steps)
+        {
+            steps = target;
+            samples = 0;
+        }
+    }
+
+private:
+    double budget;
+    int minSteps, maxSteps;
+    int steps;
+    double average = 0.0;
+    unsigned int samples = 0;
+};
+#endif
@@ -0,0 +1,393 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/render_stats.h>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// frames a pooled render target may go unused before it is deleted, e.g. the ping-pong targets after switching to
+// another bloom blur
+const unsigned int RENDER_TARGET_IDLE_FRAMES = 60;
+
+// size and format of a render target texture
+struct RenderTargetDesc {
+    unsigned int width = 0, height = 0;
+    GLenum internalFormat = GL_RGBA16F;
+
+    bool operator==(const RenderTargetDesc &other) const
+    {
+        return width == other.width && height == other.height && internalFormat == other.internalFormat;
+    }
+};
+
+bool IsDepthFormat(GLenum internalFormat)
+{
+    return internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24
+           || internalFormat == GL_DEPTH_COMPONENT32F || internalFormat == GL_DEPTH_COMPONENT;
+}
+
+size_t RenderTargetBytes(const RenderTargetDesc &desc)
+{
+    size_t bytesPerPixel = 4;
+    if (desc.internalFormat == GL_RGBA16F)
+        bytesPerPixel = 8;
+    else if (desc.internalFormat == GL_RGBA32F)
+        bytesPerPixel = 16;
+    return (size_t) desc.width * desc.height * bytesPerPixel;
+}
+
+// The textures behind the transient targets of FrameGraph, kept from frame to frame. A graph acquires a texture when
+// a target is first used and releases it after its last use, so a later target of the same size and format gets the
+// same texture: targets whose lifetimes don't overlap share memory. The framebuffers over the textures are cached too.
+class RenderTargetPool
+{
+public:
+    // a free texture of the given size and format, created if there is none
+    unsigned int Acquire(const RenderTargetDesc &desc)
+    {
+        for (Target &target : targets)
+        {
+            if (target.free && target.desc == desc)
+            {
+                target.free = false;
+                target.lastUsedFrame = frame;
+                return target.texture;
+            }
+        }
+        Target target;
+        target.desc = desc;
+        target.lastUsedFrame = frame;
+        bool depth = IsDepthFormat(desc.internalFormat);
+        glGenTextures(1, &target.texture);
+        glBindTexture(GL_TEXTURE_2D, target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0,
+                     depth ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        targets.push_back(target);
+        return target.texture;
+    }
+
+    // gives a texture back for the next Acquire of its size and format
+    void Release(unsigned int texture)
+    {
+        for (Target &target : targets)
+            if (target.texture == texture)
+                target.free = true;
+    }
+
+    // the framebuffer with colors at the color attachments of their index (0 leaves an attachment out) and depth at
+    // the depth attachment (0 for none), created the first time it is asked for
+    unsigned int Framebuffer(const vector<unsigned int> &colors, unsigned int depth)
+    {
+        vector<unsigned int> key = colors;
+        key.push_back(depth);
+        auto it = framebuffers.find(key);
+        if (it != framebuffers.end())
+            return it->second;
+
+        unsigned int fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        vector<GLenum> drawBuffers;
+        for (size_t i = 0; i < colors.size(); i++)
+        {
+            if (colors[i])
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colors[i], 0);
+            drawBuffers.push_back(colors[i] ? GL_COLOR_ATTACHMENT0 + i : GL_NONE);
+        }
+        if (drawBuffers.empty())
+            drawBuffers.push_back(GL_NONE);
+        glDrawBuffers((GLsizei) drawBuffers.size(), drawBuffers.data());
+        if (depth)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Framebuffer not complete!" << std::endl;
+        framebuffers[key] = fbo;
+        return fbo;
+    }
+
+    // deletes the textures that haven't been used for RENDER_TARGET_IDLE_FRAMES frames, with their framebuffers.
+    // call once a frame, after the graph ran.
+    void EndFrame()
+    {
+        frame++;
+        for (size_t i = 0; i < targets.size();)
+        {
+            if (targets[i].free && frame - targets[i].lastUsedFrame > RENDER_TARGET_IDLE_FRAMES)
+            {
+                deleteTarget(targets[i].texture);
+                targets.erase(targets.begin() + i);
+            }
+            else
+                i++;
+        }
+    }
+
+    size_t TextureCount() const
+    {
+        return targets.size();
+    }
+
+    size_t Bytes() const
+    {
+        size_t bytes = 0;
+        for (const Target &target : targets)
+            bytes += RenderTargetBytes(target.desc);
+        return bytes;
+    }
+
+    // deletes everything, while the context is still current
+    void Clear()
+    {
+        for (const Target &target : targets)
+            deleteTarget(target.texture);
+        targets.clear();
+    }
+
+private:
+    struct Target {
+        RenderTargetDesc desc;
+        unsigned int texture = 0;
+        bool free = false;
+        unsigned int lastUsedFrame = 0;
+    };
+
+    vector<Target> targets;
+    map<vector<unsigned int>, unsigned int> framebuffers;    // by attachments, see Framebuffer
+    unsigned int frame = 0;
+
+    void deleteTarget(unsigned int texture)
+    {
+        for (auto it = framebuffers.begin(); it != framebuffers.end();)
+        {
+            if (std::find(it->first.begin(), it->first.end(), texture) != it->first.end())
+            {
+                glDeleteFramebuffers(1, &it->second);
+                it = framebuffers.erase(it);
+            }
+            else
+                ++it;
+        }
+        glDeleteTextures(1, &texture);
+    }
+};
+
+// no resource, e.g. a framebuffer without depth
+const unsigned int FRAME_GRAPH_NONE = ~0u;
+
+// A frame's render passes and the textures they pass to each other, after the frame graph of Frostbite (O'Donnell,
+// "FrameGraph: Extensible Rendering Architecture in Frostbite", 2017). Every frame the passes are declared with the
+// resources they read and write, in the order they run. Compile culls the passes nothing depends on: a pass runs if
+// it has side effects (draws to the screen) or a running pass reads one of its outputs. Execute then runs the rest.
+// Transient textures only exist as descriptions until a pass first uses them, then come from the RenderTargetPool and
+// go back after their last use. Imported textures belong to someone else, e.g. the targets of BloomMipChain.
+class FrameGraph
+{
+public:
+    explicit FrameGraph(RenderTargetPool &pool) : pool(pool)
+    {
+    }
+
+    // a texture that lives within the frame, returns its handle
+    unsigned int CreateTexture(const char *name, const RenderTargetDesc &desc)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.desc = desc;
+        resources.push_back(resource);
+        return resources.size() - 1;
+    }
+
+    // a texture from outside of the graph. the pass writing it can set it while it runs, with SetImportedTexture.
+    unsigned int ImportTexture(const char *name, unsigned int texture = 0)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.imported = true;
+        resource.texture = texture;
+        resources.push_back(resource);
+        return resources.size() - 1;
+    }
+
+    void SetImportedTexture(unsigned int resource, unsigned int texture)
+    {
+        resources[resource].texture = texture;
+    }
+
+    // a pass reading and writing the given resources, which runs execute. passes with side effects are never culled.
+    void AddPass(const char *name, const vector<unsigned int> &reads, const vector<unsigned int> &writes,
+                 function<void()> execute, bool sideEffect = false)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.reads = reads;
+        pass.writes = writes;
+        pass.execute = std::move(execute);
+        pass.sideEffect = sideEffect;
+        passes.push_back(std::move(pass));
+    }
+
+    // culls the passes whose outputs aren't used, and finds the last pass using every resource
+    void Compile()
+    {
+        // readers of every resource, and how many outputs of every pass are read
+        vector<unsigned int> readers(resources.size(), 0);
+        vector<unsigned int> producer(resources.size(), FRAME_GRAPH_NONE);
+        vector<unsigned int> usedOutputs(passes.size(), 0);
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            for (unsigned int resource : passes[i].reads)
+                readers[resource]++;
+            for (unsigned int resource : passes[i].writes)
+                producer[resource] = i;
+        }
+        for (unsigned int i = 0; i < passes.size(); i++)
+            for (unsigned int resource : passes[i].writes)
+                usedOutputs[i] += readers[resource] > 0;
+
+        // passes without used outputs or side effects are culled, which can leave the passes before them unused too
+        vector<unsigned int> unused;
+        for (unsigned int i = 0; i < passes.size(); i++)
+            if (usedOutputs[i] == 0 && !passes[i].sideEffect)
+                unused.push_back(i);
+        while (!unused.empty())
+        {
+            Pass &pass = passes[unused.back()];
+            unused.pop_back();
+            pass.culled = true;
+            for (unsigned int resource : pass.reads)
+            {
+                if (--readers[resource] > 0 || producer[resource] == FRAME_GRAPH_NONE)
+                    continue;
+                unsigned int source = producer[resource];
+                if (--usedOutputs[source] == 0 && !passes[source].sideEffect && !passes[source].culled)
+                    unused.push_back(source);
+            }
+        }
+        for (Resource &resource : resources)
+            resource.lastUse = FRAME_GRAPH_NONE;
+        for (unsigned int i = 0; i < resources.size(); i++)
+            resources[i].read = readers[i] > 0;
+        for (unsigned int i = 0; i < passes.size(); i++)
+        {
+            if (passes[i].culled)
+                continue;
+            for (unsigned int resource : passes[i].reads)
+                resources[resource].lastUse = i;
+            for (unsigned int resource : passes[i].writes)
+                resources[resource].lastUse = i;
+        }
+        compiled = true;
+    }
+
+    // runs the passes that weren't culled, in the order they were added
+    void Execute()
+    {
+        if (!compiled)
+            Compile();
+        for (unsigned int current = 0; current < passes.size(); current++)
+        {
+            if (passes[current].culled)
+            {
+                FrameStats().passesCulled++;
+                continue;
+            }
+            passes[current].execute();
+            FrameStats().passes++;
+            for (Resource &resource : resources)
+            {
+                if (resource.lastUse == current && !resource.imported && resource.texture)
+                    pool.Release(resource.texture);
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // the texture of a resource, for the pass running. a transient one is acquired on first use.
+    unsigned int Texture(unsigned int resource)
+    {
+        Resource &target = resources[resource];
+        if (!target.imported && !target.texture)
+            target.texture = pool.Acquire(target.desc);
+        return target.texture;
+    }
+
+    // whether a pass that runs reads the resource. a pass can leave out outputs nobody reads.
+    bool Used(unsigned int resource) const
+    {
+        return resources[resource].read;
+    }
+
+    // binds a framebuffer over the given transient textures, colors in attachment order and depth, and sets the
+    // viewport to their size. colors nobody reads are left out, their attachments are GL_NONE.
+    void BindFramebuffer(const vector<unsigned int> &colors, unsigned int depth = FRAME_GRAPH_NONE)
+    {
+        vector<unsigned int> textures;
+        RenderTargetDesc desc;
+        for (unsigned int color : colors)
+        {
+            textures.push_back(Used(color) ? Texture(color) : 0);
+            if (textures.back())
+                desc = resources[color].desc;
+        }
+        unsigned int depthTexture = 0;
+        if (depth != FRAME_GRAPH_NONE)
+        {
+            depthTexture = Texture(depth);
+            desc = resources[depth].desc;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, pool.Framebuffer(textures, depthTexture));
+        glViewport(0, 0, desc.width, desc.height);
+    }
+
+    // the passes with the resources they write, and which of them were culled, after Compile
+    string Describe() const
+    {
+        std::ostringstream description;
+        for (const Pass &pass : passes)
+        {
+            description << "  " << pass.name << (pass.culled ? " (culled)" : "");
+            for (size_t i = 0; i < pass.writes.size(); i++)
+                description << (i == 0 ? " -> " : ", ") << resources[pass.writes[i]].name;
+            description << "\n";
+        }
+        return description.str();
+    }
+
+private:
+    struct Resource {
+        const char *name;
+        RenderTargetDesc desc;
+        bool imported = false;
+        unsigned int texture = 0;
+        bool read = false;                          // by a pass that runs
+        unsigned int lastUse = FRAME_GRAPH_NONE;    // index of the last pass that runs and uses the resource
+    };
+
+    struct Pass {
+        const char *name;
+        vector<unsigned int> reads, writes;
+        function<void()> execute;
+        bool sideEffect = false;
+        bool culled = false;
+    };
+
+    RenderTargetPool &pool;
+    vector<Resource> resources;
+    vector<Pass> passes;
+    bool compiled = false;
+};
+#endif
@@ -0,0 +1,109 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// Per-frame data shared by all scene shaders through two std140 uniform blocks: FrameData (camera) and Lights. Both
+// live in one uniform buffer that is rewritten once per frame. The GLSL declarations of the blocks are repeated in
+// every shader that uses them and have to match the structs below.
+
+const unsigned int FRAME_DATA_BINDING = 0;
+const unsigned int LIGHTS_BINDING = 1;
+const unsigned int MAX_LAMPS = 4;   // light cubes of the bloom pass
+
+// std140 layouts: every vec3 starts a new 16 byte slot, a float right after it fills the slot's last 4 bytes
+struct FrameDataBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 cameraPosition;
+    float time;
+};
+
+struct PointLightBlock {    // struct PointLight
+    glm::vec3 position; float padding0;
+    glm::vec3 specular; float padding1;
+    glm::vec3 diffuse; float padding2;
+    glm::vec3 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding3[2];
+};
+
+struct DirLightBlock {      // struct DirLight
+    glm::vec3 direction; float padding0;
+    glm::vec3 specular; float padding1;
+    glm::vec3 diffuse; float padding2;
+    glm::vec3 ambient; float padding3;
+};
+
+struct LampBlock {          // struct Light
+    glm::vec3 position; float padding0;
+    glm::vec3 color; float padding1;
+};
+
+struct LightsBlock {
+    PointLightBlock pointLight;
+    DirLightBlock dirLight;
+    LampBlock lamps[MAX_LAMPS];
+    glm::vec3 floorLightPosition; float padding;
+};
+
+static_assert(sizeof(FrameDataBlock) == 144, "FrameDataBlock has to match the std140 layout of FrameData");
+static_assert(sizeof(LightsBlock) == 288, "LightsBlock has to match the std140 layout of Lights");
+
+// connects the FrameData and Lights blocks of a shader to their binding points, call once after creating it
+void BindFrameUniformBlocks(const Shader &shader)
+{
+    shader.bindUniformBlock("FrameData", FRAME_DATA_BINDING);
+    shader.bindUniformBlock("Lights", LIGHTS_BINDING);
+}
+
+// the uniform buffer behind the blocks. fill in frame and lights, then Update uploads both with one write.
+class FrameUniforms
+{
+public:
+    FrameDataBlock frame;
+    LightsBlock lights;
+
+    FrameUniforms() : frame(), lights()     // value initialized, so the padding is zero too
+    {
+        // the second block has to start at an offset the driver accepts for glBindBufferRange
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        lightsOffset = (sizeof(FrameDataBlock) + alignment - 1) / alignment * alignment;
+        staging.resize(lightsOffset + sizeof(LightsBlock));
+
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, ubo, 0, sizeof(FrameDataBlock));
+        glBindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_BINDING, ubo, lightsOffset, sizeof(LightsBlock));
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // uploads frame and lights. the buffer is respecified instead of overwritten, so the driver can hand out fresh
+    // storage while the previous frame still reads the old one.
+    void Update()
+    {
+        memcpy(staging.data(), &frame, sizeof(frame));
+        memcpy(staging.data() + lightsOffset, &lights, sizeof(lights));
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), staging.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    unsigned int ubo;
+    size_t lightsOffset;
+    vector<char> staging;
+};
+#endif
@@ -0,0 +1,123 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// the six planes of a view frustum. a point p is on the inner side of a plane if dot(plane.xyz, p) + plane.w >= 0,
+// the normals are normalized, so that value is the distance to the plane.
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// extracts the frustum of a clip space matrix (Gribb/Hartmann). for projection * view the planes are in world space,
+// for projection * view * model in the model's object space, where object space bounds can be tested as they are.
+Frustum FrustumFromMatrix(const glm::mat4 &m)
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];  // left
+    frustum.planes[1] = rows[3] - rows[0];  // right
+    frustum.planes[2] = rows[3] + rows[1];  // bottom
+    frustum.planes[3] = rows[3] - rows[1];  // top
+    frustum.planes[4] = rows[3] + rows[2];  // near
+    frustum.planes[5] = rows[3] - rows[2];  // far
+    for (glm::vec4 &plane : frustum.planes)
+    {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+            plane /= length;
+    }
+    return frustum;
+}
+
+// false if the sphere lies completely outside of one of the planes
+bool SphereInFrustum(const Frustum &frustum, const glm::vec3 &center, float radius)
+{
+    for (const glm::vec4 &plane : frustum.planes)
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    return true;
+}
+
+// axis aligned boxes as separate arrays of centers and half extents, so CullBoxes can test four of them at once
+struct BoxBatch {
+    vector<float> centerX, centerY, centerZ;
+    vector<float> extentX, extentY, extentZ;
+
+    void Add(const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        glm::vec3 center = (boxMin + boxMax) * 0.5f, extent = (boxMax - boxMin) * 0.5f;
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        extentX.push_back(extent.x);
+        extentY.push_back(extent.y);
+        extentZ.push_back(extent.z);
+    }
+
+    size_t Size() const
+    {
+        return centerX.size();
+    }
+};
+
+// sets visible[i] to 1 for every box of the batch that is at least partly inside the frustum and to 0 for the others,
+// returns the number of visible boxes. a box counts as outside only if it lies completely behind one plane, so a box
+// close to an edge of the frustum can pass without being inside (conservative, never culls a visible box).
+size_t CullBoxes(const Frustum &frustum, const BoxBatch &boxes, unsigned char *visible)
+{
+    size_t count = boxes.Size(), visibleCount = 0, i = 0;
+#ifdef __SSE__
+    // four boxes per iteration: distance of the center to the plane plus the projected half extent of the box on
+    // the plane normal, negative for all four corners behind the plane
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 centerX = _mm_loadu_ps(&boxes.centerX[i]), centerY = _mm_loadu_ps(&boxes.centerY[i]), centerZ = _mm_loadu_ps(&boxes.centerZ[i]);
+        __m128 extentX = _mm_loadu_ps(&boxes.extentX[i]), extentY = _mm_loadu_ps(&boxes.extentY[i]), extentZ = _mm_loadu_ps(&boxes.extentZ[i]);
+        __m128 outside = zero;
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), centerX), _mm_mul_ps(_mm_set1_ps(plane.y), centerY)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), centerZ), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(plane.x)), extentX), _mm_mul_ps(_mm_set1_ps(std::fabs(plane.y)), extentY)),
+                                       _mm_mul_ps(_mm_set1_ps(std::fabs(plane.z)), extentZ));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            visible[i + lane] = !(mask >> lane & 1);
+            visibleCount += visible[i + lane];
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        visible[i] = 1;
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            float distance = plane.x * boxes.centerX[i] + plane.y * boxes.centerY[i] + plane.z * boxes.centerZ[i] + plane.w;
+            float radius = std::fabs(plane.x) * boxes.extentX[i] + std::fabs(plane.y) * boxes.extentY[i] + std::fabs(plane.z) * boxes.extentZ[i];
+            if (distance + radius < 0.0f)
+            {
+                visible[i] = 0;
+                break;
+            }
+        }
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
+#endif
@@ -0,0 +1,92 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// measurements a timer can have in flight, about the frames the GPU may run behind
+const unsigned int GPU_TIMER_QUERIES = 4;
+
+// Measures how long the GPU takes for the commands between Begin and End with a GL_TIMESTAMP query at either end.
+// Results are collected once the GPU has them, so reading a timer never waits; TakeAverage returns the mean of the
+// measurements that came in since its last call. Unlike GL_TIME_ELAPSED queries, timestamps let timers nest: the
+// frame timer runs around the bloom timers.
+class GpuTimer
+{
+public:
+    GpuTimer() {}
+
+    ~GpuTimer()
+    {
+        if (startQueries[0] == 0)
+            return;
+        glDeleteQueries(GPU_TIMER_QUERIES, startQueries);
+        glDeleteQueries(GPU_TIMER_QUERIES, endQueries);
+    }
+
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    void Begin()
+    {
+        if (startQueries[0] == 0)
+        {
+            glGenQueries(GPU_TIMER_QUERIES, startQueries);
+            glGenQueries(GPU_TIMER_QUERIES, endQueries);
+        }
+        collect();
+        // all queries still in flight: this measurement is skipped
+        running = !pending[current];
+        if (running)
+            glQueryCounter(startQueries[current], GL_TIMESTAMP);
+    }
+
+    void End()
+    {
+        if (!running)
+            return;
+        glQueryCounter(endQueries[current], GL_TIMESTAMP);
+        pending[current] = true;
+        current = (current + 1) % GPU_TIMER_QUERIES;
+        running = false;
+    }
+
+    // mean time in milliseconds of the measurements collected since the last call, 0 if there were none
+    double TakeAverage()
+    {
+        collect();
+        double average = samples > 0 ? totalNanoseconds / 1e6 / samples : 0.0;
+        totalNanoseconds = 0.0;
+        samples = 0;
+        return average;
+    }
+
+private:
+    unsigned int startQueries[GPU_TIMER_QUERIES] = {};
+    unsigned int endQueries[GPU_TIMER_QUERIES] = {};
+    bool pending[GPU_TIMER_QUERIES] = {};
+    unsigned int current = 0;
+    bool running = false;
+    double totalNanoseconds = 0.0;
+    unsigned int samples = 0;
+
+    void collect()
+    {
+        for (unsigned int i = 0; i < GPU_TIMER_QUERIES; i++)
+        {
+            if (!pending[i])
+                continue;
+            // the end timestamp comes after the start one, once it is there both are
+            GLuint available = 0;
+            glGetQueryObjectuiv(endQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(startQueries[i], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(endQueries[i], GL_QUERY_RESULT, &end);
+            totalNanoseconds += (double) (end - start);
+            samples++;
+            pending[i] = false;
+        }
+    }
+};
+#endif
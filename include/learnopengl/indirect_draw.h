@@ -0,0 +1,268 @@
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// Multi-draw indirect (GL 4.3) for the RenderQueue. The loader in libs/glad only covers GL 3.3, so the few entry points
+// past it are loaded here by hand, and only if the context turns out to be new enough; everything else keeps working
+// on a 3.3 context.
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRYP IndirectMultiDrawElementsProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride);
+typedef void (APIENTRYP IndirectBufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+struct IndirectDrawingFunctions {
+    IndirectMultiDrawElementsProc multiDrawElementsIndirect = nullptr;  // GL 4.3
+    IndirectBufferStorageProc bufferStorage = nullptr;                  // GL 4.4, persistently mapped buffers
+};
+
+IndirectDrawingFunctions &IndirectFunctions()
+{
+    static IndirectDrawingFunctions functions;
+    return functions;
+}
+
+// loads the multi-draw entry points if the current context has them, call once after gladLoadGLLoader. returns whether
+// indirect drawing is available.
+bool LoadIndirectDrawing(GLADloadproc load)
+{
+    IndirectDrawingFunctions &functions = IndirectFunctions();
+    int version = GLVersion.major * 10 + GLVersion.minor;
+    if (version >= 43)
+        functions.multiDrawElementsIndirect = (IndirectMultiDrawElementsProc) load("glMultiDrawElementsIndirect");
+    if (version >= 44)
+        functions.bufferStorage = (IndirectBufferStorageProc) load("glBufferStorage");
+    return functions.multiDrawElementsIndirect != nullptr;
+}
+
+bool IndirectDrawingSupported()
+{
+    return IndirectFunctions().multiDrawElementsIndirect != nullptr;
+}
+
+// one draw of glMultiDrawElementsIndirect, layout fixed by GL
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;      // in indices, not bytes
+    GLint baseVertex;
+    GLuint baseInstance;    // where the instance attributes start, the draw's entry in the draw data buffer
+};
+
+// the command drawing a LOD of a mesh once, reading its draw data at baseInstance
+DrawElementsIndirectCommand MeshIndirectCommand(const Mesh &mesh, unsigned int lod, unsigned int baseInstance)
+{
+    const MeshLod &range = mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)];
+    DrawElementsIndirectCommand command;
+    command.count = range.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = (GLuint) (mesh.indexOffset / IndexSize(mesh.indexType)) + range.firstIndex;
+    command.baseVertex = (GLint) mesh.baseVertex;
+    command.baseInstance = baseInstance;
+    return command;
+}
+
+// the model matrix with the mesh's position dequantization folded in (model * translate(offset) * scale(scale)), so
+// meshes with different packing can share one multi-draw with positionScale and positionOffset left at the identity
+glm::mat4 MeshDrawMatrix(const Mesh &mesh, const glm::mat4 &model)
+{
+    glm::mat4 matrix = model;
+    matrix[3] = model * glm::vec4(mesh.positionOffset, 1.0f);
+    matrix[0] *= mesh.positionScale.x;
+    matrix[1] *= mesh.positionScale.y;
+    matrix[2] *= mesh.positionScale.z;
+    return matrix;
+}
+
+// what the multi-draw VAOs read per draw, at the instance matrix and material layers attributes
+struct IndirectDrawData {
+    glm::mat4 model;            // with the dequantization folded in, see MeshDrawMatrix
+    glm::vec4 materialLayers;   // see Mesh::materialLayers
+};
+
+// frames whose commands can be in flight at once, each writes its own region of the persistently mapped buffers
+const unsigned int INDIRECT_FRAME_REGIONS = 3;
+// draws per frame the buffers start with, they grow when a frame needs more
+const size_t INDIRECT_INITIAL_DRAWS = 1024;
+
+// The indirect command buffer and the draw data buffer (IndirectDrawData per draw, read through the instance matrix
+// and material layers attributes) of the multi-draw path. With GL 4.4 both are mapped persistently and split
+// into a region per frame in flight, guarded by fences; on 4.3 they are respecified every frame instead. A frame goes
+// BeginFrame, Add for every draw, Upload, then Draw for ranges of the added draws, and EndFrame.
+class IndirectDrawBuffers
+{
+public:
+    // points the instance matrix and material layers attributes of vao at the draw data buffer. the VAO keeps being
+    // updated when the buffer has to grow.
+    void Attach(unsigned int vao)
+    {
+        ensureCapacity(INDIRECT_INITIAL_DRAWS);
+        attachedVAOs.push_back(vao);
+        attach(vao);
+    }
+
+    // starts a frame of at most drawCount draws
+    void BeginFrame(size_t drawCount)
+    {
+        ensureCapacity(drawCount);
+        count = 0;
+        if (!persistent)
+        {
+            commands = stagingCommands.data();
+            drawData = stagingDrawData.data();
+            regionStart = 0;
+            return;
+        }
+        region = (region + 1) % INDIRECT_FRAME_REGIONS;
+        if (fences[region])
+        {
+            // only waits if the GPU is still more than two frames behind
+            glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+        regionStart = region * capacity;
+        commands = mappedCommands + regionStart;
+        drawData = mappedDrawData + regionStart;
+    }
+
+    // adds a draw of the mesh's LOD with the given model matrix, returns its index for Draw
+    unsigned int Add(const Mesh &mesh, unsigned int lod, const glm::mat4 &model)
+    {
+        commands[count] = MeshIndirectCommand(mesh, lod, (unsigned int) (regionStart + count));
+        drawData[count].model = MeshDrawMatrix(mesh, model);
+        drawData[count].materialLayers = mesh.materialLayers;
+        return count++;
+    }
+
+    // makes the added draws visible to the GPU and binds the command buffer
+    void Upload()
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        if (persistent || count == 0)
+            return;
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, count * sizeof(DrawElementsIndirectCommand), commands);
+        glBindBuffer(GL_ARRAY_BUFFER, drawDataBuffer);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(IndirectDrawData), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(IndirectDrawData), drawData);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // draws the added draws [first, first + drawCount) with one call. expects an attached VAO to be bound, and all
+    // of the draws to be ranges of its buffers with the given index type.
+    void Draw(unsigned int first, unsigned int drawCount, GLenum indexType)
+    {
+        const void *offset = (const void*)((regionStart + first) * sizeof(DrawElementsIndirectCommand));
+        IndirectFunctions().multiDrawElementsIndirect(GL_TRIANGLES, indexType, offset, drawCount, 0);
+    }
+
+    // ends the frame, the region can be written again once the GPU passed this point
+    void EndFrame()
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        if (persistent && count > 0)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    unsigned int commandBuffer = 0, drawDataBuffer = 0;
+    size_t capacity = 0;    // draws per frame
+    bool persistent = false;
+    // persistent mapping: the whole buffers, INDIRECT_FRAME_REGIONS regions of capacity draws each
+    DrawElementsIndirectCommand *mappedCommands = nullptr;
+    IndirectDrawData *mappedDrawData = nullptr;
+    GLsync fences[INDIRECT_FRAME_REGIONS] = {};
+    unsigned int region = 0;
+    // otherwise the draws are collected here and uploaded by Upload
+    vector<DrawElementsIndirectCommand> stagingCommands;
+    vector<IndirectDrawData> stagingDrawData;
+    // the current frame
+    size_t regionStart = 0;
+    unsigned int count = 0;
+    DrawElementsIndirectCommand *commands = nullptr;
+    IndirectDrawData *drawData = nullptr;
+    vector<unsigned int> attachedVAOs;
+
+    void attach(unsigned int vao)
+    {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, drawDataBuffer);
+        SetupInstanceAttributes(sizeof(IndirectDrawData), offsetof(IndirectDrawData, model));
+        SetupMaterialLayersAttribute(sizeof(IndirectDrawData), offsetof(IndirectDrawData, materialLayers));
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // (re)creates the buffers if they can't hold drawCount draws per frame. the old ones are deleted right away, GL
+    // keeps them alive until the draws using them are done.
+    void ensureCapacity(size_t drawCount)
+    {
+        if (drawCount <= capacity)
+            return;
+        capacity = std::max(drawCount, std::max(capacity * 2, INDIRECT_INITIAL_DRAWS));
+        if (commandBuffer)
+        {
+            for (GLsync &fence : fences)
+            {
+                if (fence)
+                    glDeleteSync(fence);
+                fence = 0;
+            }
+            glDeleteBuffers(1, &commandBuffer);
+            glDeleteBuffers(1, &drawDataBuffer);
+        }
+        glGenBuffers(1, &commandBuffer);
+        glGenBuffers(1, &drawDataBuffer);
+
+        persistent = IndirectFunctions().bufferStorage != nullptr;
+        if (persistent)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            size_t commandBytes = INDIRECT_FRAME_REGIONS * capacity * sizeof(DrawElementsIndirectCommand);
+            size_t drawDataBytes = INDIRECT_FRAME_REGIONS * capacity * sizeof(IndirectDrawData);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            IndirectFunctions().bufferStorage(GL_DRAW_INDIRECT_BUFFER, commandBytes, nullptr, flags);
+            mappedCommands = (DrawElementsIndirectCommand*) glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, commandBytes, flags);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            glBindBuffer(GL_ARRAY_BUFFER, drawDataBuffer);
+            IndirectFunctions().bufferStorage(GL_ARRAY_BUFFER, drawDataBytes, nullptr, flags);
+            mappedDrawData = (IndirectDrawData*) glMapBufferRange(GL_ARRAY_BUFFER, 0, drawDataBytes, flags);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        else
+        {
+            stagingCommands.resize(capacity);
+            stagingDrawData.resize(capacity);
+        }
+
+        for (unsigned int vao : attachedVAOs)
+            attach(vao);
+    }
+};
+
+IndirectDrawBuffers &IndirectBuffers()
+{
+    static IndirectDrawBuffers buffers;
+    return buffers;
+}
+#endif
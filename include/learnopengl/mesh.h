@@ -6,9 +6,15 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/render_stats.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_array.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -25,7 +31,189 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// compact vertex layout, 20 instead of 56 bytes. the position is quantized to 16 bit relative to the mesh bounding box
+// (the shader gets positionScale/positionOffset to undo that), normal and tangent are signed normalized 10_10_10_2
+// values with the bitangent sign in the tangent's w, and the texture coordinates are half floats.
+struct PackedVertex {
+    uint16_t Position[4];   // w is padding
+    uint32_t Normal;
+    uint32_t Tangent;
+    uint32_t TexCoords;
+};
+
+// vertex layout the GPU buffers of a mesh are created with
+enum Vertex_Format {
+    VERTEX_FULL,
+    VERTEX_PACKED
+};
+
+// packs a normalized vector into GL_INT_2_10_10_10_REV layout (x in the lowest bits)
+uint32_t PackSnorm10_10_10_2(glm::vec3 v, float w)
+{
+    auto component = [](float value, float range, uint32_t mask) {
+        if (!std::isfinite(value))
+            value = 0.0f;
+        value = std::min(1.0f, std::max(-1.0f, value));
+        return (uint32_t) (int32_t) std::lround(value * range) & mask;
+    };
+    return component(v.x, 511.0f, 0x3ff) | component(v.y, 511.0f, 0x3ff) << 10 | component(v.z, 511.0f, 0x3ff) << 20
+         | component(w, 1.0f, 0x3) << 30;
+}
+
+// converts vertices to the packed layout. scale and offset receive the dequantization parameters for the shader.
+void PackVertices(const Vertex *vertices, unsigned int count, vector<PackedVertex> &packed, glm::vec3 &scale, glm::vec3 &offset)
+{
+    glm::vec3 lower(0.0f), upper(0.0f);
+    if (count > 0)
+        lower = upper = vertices[0].Position;
+    for (unsigned int i = 1; i < count; i++)
+    {
+        lower = glm::min(lower, vertices[i].Position);
+        upper = glm::max(upper, vertices[i].Position);
+    }
+    offset = lower;
+    scale = upper - lower;
+
+    packed.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const Vertex &vertex = vertices[i];
+        PackedVertex &out = packed[i];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float t = scale[axis] > 0.0f ? (vertex.Position[axis] - offset[axis]) / scale[axis] : 0.0f;
+            out.Position[axis] = (uint16_t) std::lround(std::min(1.0f, std::max(0.0f, t)) * 65535.0f);
+        }
+        out.Position[3] = 0;
+        float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+        out.Normal = PackSnorm10_10_10_2(vertex.Normal, 0.0f);
+        out.Tangent = PackSnorm10_10_10_2(vertex.Tangent, handedness);
+        out.TexCoords = glm::packHalf2x16(vertex.TexCoords);
+    }
+}
+
+size_t VertexStride(Vertex_Format format)
+{
+    return format == VERTEX_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+// meshes with at most this many vertices store their indices as 16 bit values on the GPU
+const size_t SHORT_INDEX_VERTEX_LIMIT = 65536;
+
+GLenum IndexType(size_t vertexCount)
+{
+    return vertexCount <= SHORT_INDEX_VERTEX_LIMIT ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+size_t IndexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void ShortenIndices(const unsigned int *indices, unsigned int count, vector<uint16_t> &shortIndices)
+{
+    shortIndices.assign(indices, indices + count);
+}
+
+// sets the vertex attribute pointers of the bound VAO for vertices of the given format in the bound vertex buffer
+void SetupVertexAttributes(Vertex_Format format)
+{
+    if (format == VERTEX_PACKED)
+    {
+        // packed attributes are fetched as normalized integers, so the shaders see positions in [0, 1] (to be scaled
+        // by positionScale/positionOffset) and normals/tangents in [-1, 1]. there is no bitangent array: shaders that
+        // need it compute cross(normal, tangent.xyz) * tangent.w.
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+        // vertex tangent, bitangent sign in w
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Tangent));
+        return;
+    }
 
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
+
+// instanced draws (see Model::SubmitInstanced) get a model matrix per instance in the four attributes from this
+// location, one column each. VAOs without an instance buffer leave them disabled, so they read the identity set by
+// SetDefaultInstanceMatrix.
+const unsigned int INSTANCE_MATRIX_LOCATION = 5;
+
+// the texture array layers of a draw (see Mesh::materialLayers) are read from this location. only the multi-draw VAOs
+// have a buffer for it, for the others Mesh::DrawElements sets the current value before every draw.
+const unsigned int MATERIAL_LAYERS_LOCATION = 9;
+
+// sets the instance matrix attributes of the bound VAO to step through the matrices in the bound vertex buffer,
+// stride bytes apart starting at offset
+void SetupInstanceAttributes(GLsizei stride = sizeof(glm::mat4), size_t offset = 0)
+{
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+        glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + column, 1);
+    }
+}
+
+// the same for the material layers attribute
+void SetupMaterialLayersAttribute(GLsizei stride, size_t offset)
+{
+    glEnableVertexAttribArray(MATERIAL_LAYERS_LOCATION);
+    glVertexAttribPointer(MATERIAL_LAYERS_LOCATION, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    glVertexAttribDivisor(MATERIAL_LAYERS_LOCATION, 1);
+}
+
+// the instance matrix of draws without an instance buffer. current attribute values are context state, once is enough.
+void SetDefaultInstanceMatrix()
+{
+    for (unsigned int column = 0; column < 4; column++)
+        glVertexAttrib4f(INSTANCE_MATRIX_LOCATION + column, column == 0, column == 1, column == 2, column == 3);
+}
+
+// a level of detail of a mesh: a range of its index list. all LODs of a mesh share its vertices, see mesh_simplifier.h
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;    // how far the LOD deviates from the full detail mesh, in object space units
+};
+
+// fraction of the pixel error threshold a coarser LOD has to get below before SelectLod switches to it
+const float LOD_HYSTERESIS = 0.25f;
+
+// picks the LOD to draw for a mesh of which one object space unit covers pixelsPerUnit pixels on screen: the coarsest
+// LOD whose error stays below maxPixelError. switching to a coarser LOD than current needs a margin of LOD_HYSTERESIS,
+// so a mesh that sits right at a threshold doesn't pop back and forth between two LODs.
+unsigned int SelectLod(const vector<MeshLod> &lods, unsigned int current, float pixelsPerUnit, float maxPixelError)
+{
+    if (current >= lods.size())
+        current = 0;
+    while (current > 0 && lods[current].error * pixelsPerUnit > maxPixelError)
+        current--;
+    while (current + 1 < lods.size() && lods[current + 1].error * pixelsPerUnit <= maxPixelError * (1.0f - LOD_HYSTERESIS))
+        current++;
+    return current;
+}
 
 struct Texture {
     unsigned int id;
@@ -33,107 +221,285 @@ struct Texture {
     string path;
 };
 
+// material textures go to fixed texture units, MAX_MATERIAL_TEXTURES per type in the order of MATERIAL_TEXTURE_TYPES:
+// texture_diffuse1 is unit 0, texture_diffuse2 unit 1, texture_specular1 unit 4 and so on. the samplers of a shader
+// are pointed at them once with SetMaterialSamplerUnits, so drawing a mesh only binds its textures.
+const unsigned int MAX_MATERIAL_TEXTURES = 4;
+const unsigned int MATERIAL_TEXTURE_TYPE_COUNT = 4;
+const char *const MATERIAL_TEXTURE_TYPES[MATERIAL_TEXTURE_TYPE_COUNT] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+
+// unit of the number-th (counting from 1) texture of a type, -1 for unknown types or too many textures of a type
+int MaterialTextureUnit(const string &type, unsigned int number)
+{
+    if (number == 0 || number > MAX_MATERIAL_TEXTURES)
+        return -1;
+    for (unsigned int i = 0; i < MATERIAL_TEXTURE_TYPE_COUNT; i++)
+        if (type == MATERIAL_TEXTURE_TYPES[i])
+            return i * MAX_MATERIAL_TEXTURES + number - 1;
+    return -1;
+}
+
+// the first texture of every type can also come from a texture array (see texture_array.h), which has its own unit
+// after the 2D ones: texture_diffuse_array, texture_specular_array and so on
+unsigned int MaterialArrayUnit(unsigned int typeIndex)
+{
+    return MAX_MATERIAL_TEXTURES * MATERIAL_TEXTURE_TYPE_COUNT + typeIndex;
+}
+
+// all units material textures can be bound to
+const unsigned int MATERIAL_TEXTURE_UNITS = MAX_MATERIAL_TEXTURES * MATERIAL_TEXTURE_TYPE_COUNT + MATERIAL_TEXTURE_TYPE_COUNT;
+
+// sets the material samplers of a shader (e.g. material.texture_diffuse1 with prefix "material.") to their units.
+// call once after creating the shader; samplers the shader doesn't have are skipped.
+void SetMaterialSamplerUnits(Shader &shader, const string &prefix = "")
+{
+    shader.use();
+    for (unsigned int i = 0; i < MATERIAL_TEXTURE_TYPE_COUNT; i++)
+    {
+        for (unsigned int number = 1; number <= MAX_MATERIAL_TEXTURES; number++)
+            shader.setInt(prefix + MATERIAL_TEXTURE_TYPES[i] + std::to_string(number), MaterialTextureUnit(MATERIAL_TEXTURE_TYPES[i], number));
+        shader.setInt(prefix + MATERIAL_TEXTURE_TYPES[i] + "_array", MaterialArrayUnit(i));
+    }
+}
+
+// a texture of a mesh with the unit it is bound to
+struct TextureBinding {
+    unsigned int unit;
+    unsigned int id;
+    GLenum target = GL_TEXTURE_2D;
+};
+
+// A mesh is a range of its model's shared vertex and index buffers (see Model::layoutMeshes) plus its textures.
+// It doesn't own any GL objects: the model binds its VAO once and every mesh only binds its textures and draws
+// its range with glDrawElementsBaseVertex.
 class Mesh {
 public:
     // mesh Data
-    vector<Vertex>       vertices;
+    vector<Vertex>       vertices;  // empty for meshes whose data lives in a mapped mesh cache file
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
-    unsigned int VAO;
-    std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    unsigned int vertexCount;
+    unsigned int indexCount;    // all LODs together
+    vector<MeshLod> lods;       // at least one, LOD 0 is the full detail mesh
+    GLenum indexType;   // GL_UNSIGNED_SHORT whenever the vertex count allows it
+    Vertex_Format vertexFormat;
+    glm::vec3 positionScale, positionOffset;    // dequantization of packed positions, identity for full vertices
+    glm::vec3 boundsMin, boundsMax;             // object space bounding box, see ComputeBounds
+    float boundsRadius;                         // bounding sphere around the center of the box
+    glm::vec4 materialLayers;                   // array layer per texture type, -1 where the 2D texture is bound
+    // range in the model's buffers
+    unsigned int baseVertex;    // first vertex, added to every index
+    size_t indexOffset;         // byte offset of the first index
+    bool resident;  // false while the mesh is still waiting for its buffers or textures
+
+    // constructor. only the CPU side data is kept, no GL calls are made (so it can run on a loader thread).
+    // the buffers are filled later with Upload.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, Vertex_Format format = VERTEX_FULL)
+        : Mesh(vertices.size(), indices.size(), textures, format)
     {
         this->vertices = vertices;
         this->indices = indices;
-        this->textures = textures;
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // constructor for data that stays in memory elsewhere (e.g. a mapped mesh cache file) and is passed to Upload.
+    Mesh(unsigned int vertexCount, unsigned int indexCount, vector<Texture> textures, Vertex_Format format = VERTEX_FULL)
+        : textures(textures), vertexCount(vertexCount), indexCount(indexCount), lods(1, MeshLod{0, indexCount, 0.0f}),
+          indexType(IndexType(vertexCount)), vertexFormat(format), positionScale(1.0f), positionOffset(0.0f),
+          boundsMin(0.0f), boundsMax(0.0f), boundsRadius(0.0f), materialLayers(-1.0f), baseVertex(0), indexOffset(0), resident(false),
+          materialKey(0), uniformShader(0), uploadedBytes(0), staged(false)
+    {
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // copies the next part of the vertex/index data into the mesh's range, at most byteBudget bytes. vertexData and
+    // indexData hold the mesh in its import layout, they are converted to the GPU layout on the first call.
+    // the model's VAO and vertex buffer have to be bound. returns the number of bytes uploaded; IsUploaded tells
+    // when the range is complete.
+    size_t Upload(size_t byteBudget, const Vertex *vertexData, const unsigned int *indexData)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        if (!staged)
+        {
+            if (vertexFormat == VERTEX_PACKED)
+                PackVertices(vertexData, vertexCount, packedVertices, positionScale, positionOffset);
+            if (indexType == GL_UNSIGNED_SHORT)
+                ShortenIndices(indexData, indexCount, shortIndices);
+            staged = true;
+        }
+        const char *vertexSource = vertexFormat == VERTEX_PACKED ? (const char *) packedVertices.data() : (const char *) vertexData;
+        const char *indexSource = indexType == GL_UNSIGNED_SHORT ? (const char *) shortIndices.data() : (const char *) indexData;
+
+        size_t vertexBytes = VertexBufferBytes();
+        size_t totalBytes = vertexBytes + IndexBufferBytes();
+        size_t start = uploadedBytes;
+        size_t end = std::min(totalBytes, uploadedBytes + byteBudget);
+        if (uploadedBytes < end && uploadedBytes < vertexBytes)
+        {
+            size_t chunkEnd = std::min(end, vertexBytes);
+            glBufferSubData(GL_ARRAY_BUFFER, baseVertex * VertexStride(vertexFormat) + uploadedBytes, chunkEnd - uploadedBytes, vertexSource + uploadedBytes);
+            uploadedBytes = chunkEnd;
+        }
+        if (uploadedBytes < end)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            size_t offset = uploadedBytes - vertexBytes;
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexOffset + offset, end - uploadedBytes, indexSource + offset);
+            uploadedBytes = end;
         }
+        if (IsUploaded())
+        {
+            vector<PackedVertex>().swap(packedVertices);
+            vector<uint16_t>().swap(shortIndices);
+        }
+        return uploadedBytes - start;
+    }
 
+    // assigns the textures their units (see MaterialTextureUnit), call once their ids are final. with arraySlots the
+    // first texture of every type that has a slot is bound as its texture array instead, and its layer goes into
+    // materialLayers; meshes whose textures share arrays then have the same bindings and material key.
+    void ResolveTextureBindings(const unordered_map<unsigned int, TextureArraySlot> *arraySlots = nullptr)
+    {
+        unsigned int counts[MATERIAL_TEXTURE_TYPE_COUNT] = {0};
+        textureBindings.clear();
+        materialLayers = glm::vec4(-1.0f);
+        materialKey = 14695981039346656037ull;  // FNV-1a over the bindings
+        for (const Texture &texture : textures)
+        {
+            for (unsigned int i = 0; i < MATERIAL_TEXTURE_TYPE_COUNT; i++)
+            {
+                if (texture.type != MATERIAL_TEXTURE_TYPES[i])
+                    continue;
+                const TextureArraySlot *slot = nullptr;
+                if (++counts[i] == 1 && arraySlots)
+                {
+                    auto found = arraySlots->find(texture.id);
+                    if (found != arraySlots->end())
+                        slot = &found->second;
+                }
+                TextureBinding binding;
+                if (slot)
+                {
+                    binding = TextureBinding{MaterialArrayUnit(i), slot->array, GL_TEXTURE_2D_ARRAY};
+                    materialLayers[i] = (float) slot->layer;
+                }
+                else
+                {
+                    int unit = MaterialTextureUnit(texture.type, counts[i]);
+                    if (unit < 0)
+                        break;
+                    binding = TextureBinding{(unsigned int) unit, texture.id, GL_TEXTURE_2D};
+                }
+                textureBindings.push_back(binding);
+                materialKey = (materialKey ^ ((uint64_t) binding.unit << 32 | binding.id)) * 1099511628211ull;
+                break;
+            }
+        }
+    }
 
+    const vector<TextureBinding> &TextureBindings() const
+    {
+        return textureBindings;
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // the same for all meshes with the same texture bindings, so draws can be grouped by material
+    uint64_t MaterialKey() const
+    {
+        return materialKey;
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    bool IsUploaded() const
+    {
+        return uploadedBytes == VertexBufferBytes() + IndexBufferBytes();
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    // size of the mesh's range in the vertex buffer
+    size_t VertexBufferBytes() const
+    {
+        return (size_t) vertexCount * VertexStride(vertexFormat);
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // size of the mesh's range in the index buffer
+    size_t IndexBufferBytes() const
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        return (size_t) indexCount * IndexSize(indexType);
+    }
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    // fills in the bounding box and sphere from the mesh's vertices in their import layout
+    void ComputeBounds(const Vertex *vertexData)
+    {
+        if (vertexCount == 0)
+            return;
+        boundsMin = boundsMax = vertexData[0].Position;
+        for (unsigned int i = 1; i < vertexCount; i++)
+        {
+            boundsMin = glm::min(boundsMin, vertexData[i].Position);
+            boundsMax = glm::max(boundsMax, vertexData[i].Position);
+        }
+        // the farthest vertex from the box center, usually well inside the box's corners
+        glm::vec3 center = BoundsCenter();
+        float radiusSquared = 0.0f;
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            glm::vec3 offset = vertexData[i].Position - center;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        boundsRadius = std::sqrt(radiusSquared);
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    glm::vec3 BoundsCenter() const
+    {
+        return (boundsMin + boundsMax) * 0.5f;
+    }
 
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    // render the mesh at the given level of detail, expects the model's VAO to be bound
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        // bind appropriate textures
+        for (const TextureBinding &binding : textureBindings)
+        {
+            glActiveTexture(GL_TEXTURE0 + binding.unit);
+            glBindTexture(binding.target, binding.id);
+        }
+        DrawElements(shader, lod);
 
-        glBindVertexArray(0);
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
     }
+
+    // draws the LOD's index range only, for callers that bind the VAO and textures themselves (see RenderQueue).
+    // more than one instance needs a VAO with an instance buffer, see SetupInstanceAttributes.
+    void DrawElements(Shader &shader, unsigned int lod = 0, unsigned int instanceCount = 1)
+    {
+        if (uniformShader != shader.ID)
+        {
+            positionScaleUniform = shader.uniform("positionScale");
+            positionOffsetUniform = shader.uniform("positionOffset");
+            uniformShader = shader.ID;
+        }
+        shader.setVec3(positionScaleUniform, positionScale);
+        shader.setVec3(positionOffsetUniform, positionOffset);
+        glVertexAttrib4f(MATERIAL_LAYERS_LOCATION, materialLayers.x, materialLayers.y, materialLayers.z, materialLayers.w);
+
+        // draw mesh
+        const MeshLod &range = lods[std::min<size_t>(lod, lods.size() - 1)];
+        void *firstIndex = (void*)(indexOffset + range.firstIndex * IndexSize(indexType));
+        if (instanceCount == 1)
+            glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, indexType, firstIndex, baseVertex);
+        else
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, indexType, firstIndex, instanceCount, baseVertex);
+        RenderStats &stats = FrameStats();
+        stats.drawCalls++;
+        stats.triangles += (size_t) range.indexCount / 3 * instanceCount;
+        stats.fullDetailTriangles += (size_t) lods[0].indexCount / 3 * instanceCount;
+    }
+
+private:
+    vector<TextureBinding> textureBindings;
+    uint64_t materialKey;
+    // uniforms of the shader the mesh was last drawn with
+    unsigned int uniformShader;
+    UniformLocation positionScaleUniform, positionOffsetUniform;
+    size_t uploadedBytes;
+    bool staged;    // the data below is prepared
+    vector<PackedVertex> packedVertices;    // staging copies in the GPU layout until the mesh is uploaded
+    vector<uint16_t> shortIndices;
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,357 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/filesystem.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// On-disk mesh cache. One file per source asset holds the final Vertex/index arrays of every mesh plus the
+// material texture references, so a warm start can map the file and hand the arrays straight to glBufferData
+// instead of running the Assimp import again.
+//
+// File layout (all blocks are 8 byte aligned):
+//   MeshCacheHeader
+//   source path (sourcePathLength bytes)
+//   meshCount x { MeshCacheEntry, textureCount x (MeshCacheTextureRef, type, path), MeshLod[lodCount],
+//                 Vertex[vertexCount], unsigned int[indexCount] }
+//
+// A file is only used if its key (format version, source path, source mtime/size, the mtime/size of the files the
+// source pulls geometry and materials from, import flags and vertex layout) matches the current one and its index
+// lists and LOD ranges stay inside the mesh, anything else falls back to a regular import which then rewrites the file.
+
+// version 2: meshes are stored after the optimization passes of mesh_optimizer.h
+// version 3: meshes too big for 16 bit indices are split
+// version 4: LOD chains from mesh_simplifier.h, appended to the index lists
+// version 5: bounding box and sphere of every mesh
+// version 6: stamp of the external glTF buffers and OBJ material libraries
+const uint32_t MESH_CACHE_VERSION = 6;
+const char MESH_CACHE_MAGIC[8] = {'R', 'G', 'M', 'E', 'S', 'H', 'C', '\0'};
+const char *const MESH_CACHE_DIRECTORY = "resources/cache";
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t importFlags;
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    uint32_t vertexStride;
+    uint32_t meshCount;
+    uint32_t sourcePathLength;
+    uint32_t reserved;
+    uint64_t dependencyStamp;   // see MeshCacheDependencyStamp
+};
+
+struct MeshCacheEntry {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    float boundsRadius;
+    uint32_t reserved;
+};
+
+struct MeshCacheTextureRef {
+    uint32_t typeLength;
+    uint32_t pathLength;
+};
+
+// cache files live in MESH_CACHE_DIRECTORY and are named after a hash of the source path
+string MeshCachePath(const string &sourcePath)
+{
+    std::stringstream name;
+    name << std::hex << std::hash<string>()(sourcePath) << ".meshcache";
+    return FileSystem::getPath(MESH_CACHE_DIRECTORY) + "/" + name.str();
+}
+
+// the files next to the source an import reads as well: the external buffers of a .gltf (which hold its geometry) and
+// the material libraries of an .obj (which name its textures). paths are relative to the source's directory.
+vector<string> MeshCacheDependencies(const string &sourcePath)
+{
+    vector<string> dependencies;
+    std::ifstream in(sourcePath, std::ios::binary);
+    if (!in)
+        return dependencies;
+    string extension = sourcePath.substr(sourcePath.find_last_of('.') + 1);
+    if (extension == "gltf")
+    {
+        std::stringstream contents;
+        contents << in.rdbuf();
+        string json = contents.str();
+        // the "uri" strings inside the "buffers" array, the ones of the images are textures
+        size_t start = json.find("\"buffers\"");
+        start = start == string::npos ? start : json.find('[', start);
+        if (start == string::npos)
+            return dependencies;
+        size_t end = start;
+        for (int depth = 0; end < json.size(); end++)
+        {
+            if (json[end] == '[')
+                depth++;
+            else if (json[end] == ']' && --depth == 0)
+                break;
+        }
+        for (size_t uri = json.find("\"uri\"", start); uri < end; uri = json.find("\"uri\"", uri + 1))
+        {
+            size_t open = json.find('"', json.find(':', uri + 5));
+            size_t close = open == string::npos ? open : json.find('"', open + 1);
+            if (close == string::npos || close > end)
+                break;
+            string path = json.substr(open + 1, close - open - 1);
+            if (path.compare(0, 5, "data:") != 0)   // embedded buffers are part of the source
+                dependencies.push_back(path);
+        }
+    }
+    else if (extension == "obj")
+    {
+        string line;
+        while (std::getline(in, line))
+        {
+            if (line.compare(0, 7, "mtllib ") != 0)
+                continue;
+            string path = line.substr(7);
+            path.erase(path.find_last_not_of(" \t\r") + 1);
+            dependencies.push_back(path);
+        }
+    }
+    return dependencies;
+}
+
+// combines the mtime and size of the source's dependencies into one value, a file that is missing counts as well
+uint64_t MeshCacheDependencyStamp(const string &sourcePath)
+{
+    string directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+    uint64_t stamp = 14695981039346656037ull;   // FNV-1a over the stats
+    auto mix = [&stamp](uint64_t value) {
+        stamp = (stamp ^ value) * 1099511628211ull;
+    };
+    for (const string &dependency : MeshCacheDependencies(sourcePath))
+    {
+        mix(std::hash<string>()(dependency));
+        struct stat dependencyStat;
+        if (stat((directory + '/' + dependency).c_str(), &dependencyStat) != 0)
+        {
+            mix(~0ull);
+            continue;
+        }
+        mix((uint64_t) dependencyStat.st_mtime);
+        mix((uint64_t) dependencyStat.st_size);
+    }
+    return stamp;
+}
+
+// a mesh as it is laid out inside a mapped cache file, the pointers stay valid as long as the MeshCacheFile is open
+struct CachedMesh {
+    const Vertex *vertices;
+    unsigned int vertexCount;
+    const unsigned int *indices;
+    unsigned int indexCount;
+    vector<Texture> textures;   // only type and path are filled in, ids are resolved by the model
+    vector<MeshLod> lods;
+    glm::vec3 boundsMin, boundsMax;
+    float boundsRadius;
+};
+
+// read-only memory mapping of a cache file
+class MeshCacheFile
+{
+public:
+    vector<CachedMesh> meshes;
+
+    MeshCacheFile() : data(nullptr), size(0) {}
+    ~MeshCacheFile()
+    {
+        if (data)
+            munmap(data, size);
+    }
+    MeshCacheFile(const MeshCacheFile &) = delete;
+    MeshCacheFile &operator=(const MeshCacheFile &) = delete;
+
+    // maps the cache file of the given source asset and validates its key, returns false if there is no usable cache
+    bool Open(const string &sourcePath, unsigned int importFlags)
+    {
+        struct stat sourceStat;
+        if (stat(sourcePath.c_str(), &sourceStat) != 0)
+            return false;
+
+        string cachePath = MeshCachePath(sourcePath);
+        int fd = open(cachePath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat cacheStat;
+        if (fstat(fd, &cacheStat) != 0 || cacheStat.st_size < (off_t) sizeof(MeshCacheHeader)) {
+            close(fd);
+            return false;
+        }
+        size = (size_t) cacheStat.st_size;
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);  // the mapping keeps its own reference to the file
+        if (mapping == MAP_FAILED)
+            return false;
+        data = static_cast<char *>(mapping);
+
+        const MeshCacheHeader *header = reinterpret_cast<const MeshCacheHeader *>(data);
+        if (memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0
+            || header->version != MESH_CACHE_VERSION
+            || header->importFlags != importFlags
+            || header->sourceMtime != (int64_t) sourceStat.st_mtime
+            || header->sourceSize != (uint64_t) sourceStat.st_size
+            || header->vertexStride != sizeof(Vertex)
+            || header->sourcePathLength != sourcePath.size()
+            || header->dependencyStamp != MeshCacheDependencyStamp(sourcePath))
+            return false;
+
+        size_t offset = sizeof(MeshCacheHeader);
+        const char *storedPath = readBlock(offset, header->sourcePathLength);
+        if (!storedPath || sourcePath.compare(0, string::npos, storedPath, header->sourcePathLength) != 0)
+            return false;
+
+        meshes.reserve(header->meshCount);
+        for (uint32_t i = 0; i < header->meshCount; i++) {
+            const MeshCacheEntry *entry = reinterpret_cast<const MeshCacheEntry *>(readBlock(offset, sizeof(MeshCacheEntry)));
+            if (!entry)
+                return false;
+
+            CachedMesh mesh;
+            for (uint32_t j = 0; j < entry->textureCount; j++) {
+                const MeshCacheTextureRef *ref = reinterpret_cast<const MeshCacheTextureRef *>(readBlock(offset, sizeof(MeshCacheTextureRef)));
+                if (!ref)
+                    return false;
+                const char *type = readBlock(offset, ref->typeLength);
+                const char *path = readBlock(offset, ref->pathLength);
+                if (!type || !path)
+                    return false;
+                Texture texture;
+                texture.id = 0;
+                texture.type.assign(type, ref->typeLength);
+                texture.path.assign(path, ref->pathLength);
+                mesh.textures.push_back(texture);
+            }
+            const MeshLod *lods = reinterpret_cast<const MeshLod *>(readBlock(offset, (size_t) entry->lodCount * sizeof(MeshLod)));
+            if (!lods || entry->lodCount == 0)
+                return false;
+            for (uint32_t j = 0; j < entry->lodCount; j++) {
+                if ((uint64_t) lods[j].firstIndex + lods[j].indexCount > entry->indexCount)
+                    return false;
+            }
+            mesh.lods.assign(lods, lods + entry->lodCount);
+            mesh.boundsMin = glm::vec3(entry->boundsMin[0], entry->boundsMin[1], entry->boundsMin[2]);
+            mesh.boundsMax = glm::vec3(entry->boundsMax[0], entry->boundsMax[1], entry->boundsMax[2]);
+            mesh.boundsRadius = entry->boundsRadius;
+
+            mesh.vertexCount = entry->vertexCount;
+            mesh.vertices = reinterpret_cast<const Vertex *>(readBlock(offset, (size_t) entry->vertexCount * sizeof(Vertex)));
+            mesh.indexCount = entry->indexCount;
+            mesh.indices = reinterpret_cast<const unsigned int *>(readBlock(offset, (size_t) entry->indexCount * sizeof(unsigned int)));
+            if (!mesh.vertices || !mesh.indices)
+                return false;
+            // a damaged file must not make the GPU read past the vertex buffer
+            for (uint32_t j = 0; j < mesh.indexCount; j++) {
+                if (mesh.indices[j] >= mesh.vertexCount)
+                    return false;
+            }
+            meshes.push_back(mesh);
+        }
+        return true;
+    }
+
+private:
+    char *data;
+    size_t size;
+
+    // returns a pointer to the next block and advances past it (including padding), nullptr if the file is truncated
+    const char *readBlock(size_t &offset, size_t length) const
+    {
+        if (offset > size || length > size - offset)
+            return nullptr;
+        const char *block = data + offset;
+        offset = (offset + length + 7) & ~(size_t) 7;
+        return block;
+    }
+};
+
+// writes the cache file for a freshly imported model. Written to a temporary file first and renamed into place,
+// so a crash while writing never leaves a half written cache behind.
+bool WriteMeshCache(const string &sourcePath, unsigned int importFlags, const vector<Mesh> &meshes)
+{
+    struct stat sourceStat;
+    if (stat(sourcePath.c_str(), &sourceStat) != 0)
+        return false;
+
+    mkdir(FileSystem::getPath(MESH_CACHE_DIRECTORY).c_str(), 0755);
+    string cachePath = MeshCachePath(sourcePath);
+    string tmpPath = cachePath + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+
+    const char padding[8] = {0};
+    auto writeBlock = [&](const void *block, size_t length) {
+        out.write(static_cast<const char *>(block), length);
+        out.write(padding, (8 - length % 8) % 8);
+    };
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.importFlags = importFlags;
+    header.sourceMtime = (int64_t) sourceStat.st_mtime;
+    header.sourceSize = (uint64_t) sourceStat.st_size;
+    header.vertexStride = sizeof(Vertex);
+    header.meshCount = meshes.size();
+    header.sourcePathLength = sourcePath.size();
+    header.dependencyStamp = MeshCacheDependencyStamp(sourcePath);
+    writeBlock(&header, sizeof(header));
+    writeBlock(sourcePath.data(), sourcePath.size());
+
+    for (const Mesh &mesh : meshes) {
+        MeshCacheEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.vertexCount = mesh.vertices.size();
+        entry.indexCount = mesh.indices.size();
+        entry.textureCount = mesh.textures.size();
+        entry.lodCount = mesh.lods.size();
+        for (int axis = 0; axis < 3; axis++) {
+            entry.boundsMin[axis] = mesh.boundsMin[axis];
+            entry.boundsMax[axis] = mesh.boundsMax[axis];
+        }
+        entry.boundsRadius = mesh.boundsRadius;
+        writeBlock(&entry, sizeof(entry));
+        for (const Texture &texture : mesh.textures) {
+            MeshCacheTextureRef ref;
+            ref.typeLength = texture.type.size();
+            ref.pathLength = texture.path.size();
+            writeBlock(&ref, sizeof(ref));
+            writeBlock(texture.type.data(), texture.type.size());
+            writeBlock(texture.path.data(), texture.path.size());
+        }
+        writeBlock(mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+        writeBlock(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+        writeBlock(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    }
+
+    out.close();
+    if (!out || std::rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,349 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// Post-import optimization of indexed triangle lists. It runs once when a model is imported with Assimp, the result
+// ends up in the mesh cache. The passes are:
+//   1. triangle order for the post-transform vertex cache (Forsyth's "Linear-Speed Vertex Cache Optimisation")
+//   2. overdraw: the cache friendly order is cut into clusters, which are sorted so that clusters on the outside of
+//      the mesh facing away from its center are drawn first (Sander et al., "Fast Triangle Reordering for Vertex
+//      Locality and Reduced Overdraw")
+//   3. vertex fetch: vertices are renumbered in the order the index buffer first uses them, unused ones are dropped
+
+const unsigned int VERTEX_CACHE_SCORE_SIZE = 32;    // LRU cache size the Forsyth scores are tuned for
+const unsigned int VERTEX_CACHE_FIFO_SIZE = 16;     // FIFO cache size used for statistics and overdraw clustering
+const float OVERDRAW_CLUSTER_THRESHOLD = 1.05f;     // how much a cluster's ACMR may exceed the whole mesh's
+
+struct VertexCacheStats {
+    float acmr;     // average cache miss ratio, transformed vertices per triangle (0.5 at best, 3 at worst)
+    float atvr;     // average transform to vertex ratio, transformed vertices per referenced vertex (1 at best)
+};
+
+// simulates a FIFO post-transform cache over the index list. perTriangleMisses, if given, receives the number of
+// misses of every triangle.
+VertexCacheStats AnalyzeVertexCache(const vector<unsigned int> &indices, size_t vertexCount,
+                                    vector<unsigned int> *perTriangleMisses = nullptr)
+{
+    // a vertex is in the cache if it was inserted during the last VERTEX_CACHE_FIFO_SIZE insertions
+    vector<unsigned int> timestamps(vertexCount, 0);
+    vector<bool> referenced(vertexCount, false);
+    unsigned int time = VERTEX_CACHE_FIFO_SIZE + 1;
+    unsigned int misses = 0, uniqueVertices = 0;
+    if (perTriangleMisses)
+        perTriangleMisses->assign(indices.size() / 3, 0);
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int vertex = indices[i];
+        if (time - timestamps[vertex] > VERTEX_CACHE_FIFO_SIZE)
+        {
+            timestamps[vertex] = time++;
+            misses++;
+            if (perTriangleMisses)
+                (*perTriangleMisses)[i / 3]++;
+        }
+        if (!referenced[vertex])
+        {
+            referenced[vertex] = true;
+            uniqueVertices++;
+        }
+    }
+
+    VertexCacheStats stats;
+    stats.acmr = indices.size() >= 3 ? (float) misses / (indices.size() / 3) : 0.0f;
+    stats.atvr = uniqueVertices > 0 ? (float) misses / uniqueVertices : 0.0f;
+    return stats;
+}
+
+// Forsyth's vertex score: recently used vertices score high (the last triangle's three equally), and vertices with
+// few remaining triangles get a boost so they are finished off instead of left behind as isolated triangles
+float forsythVertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = pow(1.0f - (cachePosition - 3) / (float) (VERTEX_CACHE_SCORE_SIZE - 3), 1.5f);
+    }
+    return score + 2.0f * pow((float) remainingTriangles, -0.5f);
+}
+
+// reorders the triangles for the post-transform vertex cache
+void OptimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles using each vertex; the first remaining[v] entries of a vertex' list are the ones not emitted yet
+    vector<unsigned int> remaining(vertexCount, 0), offsets(vertexCount + 1, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    vector<unsigned int> cache, newCache;
+    size_t cursor = 0;  // no triangle before it is left, used when the cache has nothing to offer
+    long best = -1;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if (best < 0)
+        {
+            while (emitted[cursor])
+                cursor++;
+            best = cursor;
+        }
+        const unsigned int *triangle = &indices[3 * best];
+        emitted[best] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // the triangle's vertices move to the front of the cache
+        newCache.clear();
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int vertex = triangle[k];
+            if (std::find(newCache.begin(), newCache.end(), vertex) != newCache.end())
+                continue;   // degenerate triangle
+            newCache.push_back(vertex);
+            unsigned int *list = &adjacency[offsets[vertex]];
+            unsigned int *found = std::find(list, list + remaining[vertex], (unsigned int) best);
+            if (found != list + remaining[vertex])
+            {
+                *found = list[remaining[vertex] - 1];
+                remaining[vertex]--;
+            }
+        }
+        for (unsigned int vertex : cache)
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                newCache.push_back(vertex);
+
+        // rescore everything that was touched, including vertices that just fell out of the cache
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            unsigned int vertex = newCache[i];
+            cachePosition[vertex] = i < VERTEX_CACHE_SCORE_SIZE ? (int) i : -1;
+            float score = forsythVertexScore(cachePosition[vertex], remaining[vertex]);
+            float delta = score - vertexScore[vertex];
+            vertexScore[vertex] = score;
+            for (unsigned int j = 0; j < remaining[vertex]; j++)
+                triangleScore[adjacency[offsets[vertex] + j]] += delta;
+        }
+        if (newCache.size() > VERTEX_CACHE_SCORE_SIZE)
+            newCache.resize(VERTEX_CACHE_SCORE_SIZE);
+        cache.swap(newCache);
+
+        // the next triangle is the best one using a cached vertex
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int vertex : cache)
+            for (unsigned int j = 0; j < remaining[vertex]; j++)
+            {
+                unsigned int t = adjacency[offsets[vertex] + j];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+    }
+    indices.swap(result);
+}
+
+// reorders clusters of the (already cache optimized) triangle list to reduce overdraw
+void OptimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    vector<unsigned int> misses;
+    float meshAcmr = AnalyzeVertexCache(indices, vertices.size(), &misses).acmr;
+
+    // a triangle missing all three vertices starts a new patch of the mesh (hard boundary). inside a patch, a cluster
+    // is closed as soon as its own ACMR, simulated with a cache that starts out empty as it would after drawing any
+    // other cluster, is close to the mesh's. that keeps most of the cache efficiency.
+    vector<size_t> clusterStarts(1, 0);
+    vector<unsigned int> timestamps(vertices.size(), 0);
+    unsigned int time = 1, clusterStartTime = 1, clusterMisses = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        size_t start = clusterStarts.back();
+        if (t > start && misses[t] == 3)
+        {
+            clusterStarts.push_back(t);
+            start = t;
+            clusterStartTime = time;
+            clusterMisses = 0;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int vertex = indices[3 * t + k];
+            if (timestamps[vertex] < clusterStartTime || time - timestamps[vertex] > VERTEX_CACHE_FIFO_SIZE)
+            {
+                timestamps[vertex] = time++;
+                clusterMisses++;
+            }
+        }
+        if (t + 1 < triangleCount && clusterMisses <= (t + 1 - start) * meshAcmr * OVERDRAW_CLUSTER_THRESHOLD)
+        {
+            clusterStarts.push_back(t + 1);
+            clusterStartTime = time;
+            clusterMisses = 0;
+        }
+    }
+    size_t clusterCount = clusterStarts.size();
+    clusterStarts.push_back(triangleCount);
+
+    // area weighted centroid and normal per cluster
+    vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f)), normals(clusterCount, glm::vec3(0.0f));
+    vector<float> areas(clusterCount, 0.0f);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            const glm::vec3 &a = vertices[indices[3 * t]].Position;
+            const glm::vec3 &b = vertices[indices[3 * t + 1]].Position;
+            const glm::vec3 &c2 = vertices[indices[3 * t + 2]].Position;
+            glm::vec3 normal = glm::cross(b - a, c2 - a);
+            float area = glm::length(normal);
+            centroids[c] += (a + b + c2) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+        if (areas[c] > 0.0f)
+            centroids[c] /= areas[c];
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    vector<float> sortKeys(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float length = glm::length(normals[c]);
+        if (length > 0.0f)
+            sortKeys[c] = glm::dot(centroids[c] - meshCentroid, normals[c] / length);
+    }
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c : order)
+        result.insert(result.end(), indices.begin() + 3 * clusterStarts[c], indices.begin() + 3 * clusterStarts[c + 1]);
+    indices.swap(result);
+}
+
+// renumbers the vertices in the order of first use, so vertex fetches walk through memory linearly
+void OptimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    vector<unsigned int> remap(vertices.size(), UINT_MAX);
+    vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == UINT_MAX)
+        {
+            remap[index] = reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
+
+// a piece of a split mesh, with its own vertex numbering
+struct MeshPart {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+};
+
+// splits a triangle list into consecutive parts that use at most maxVertices vertices each, e.g. to fit 16 bit
+// indices. after OptimizeVertexFetch the vertices of a part are mostly a contiguous range of the original ones.
+vector<MeshPart> SplitMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices, size_t maxVertices)
+{
+    vector<MeshPart> parts(1);
+    vector<unsigned int> remap(vertices.size(), UINT_MAX);  // original vertex -> vertex of the current part
+    vector<unsigned int> used;                               // original vertices of the current part
+    for (size_t t = 0; t < indices.size() / 3; t++)
+    {
+        const unsigned int *triangle = &indices[3 * t];
+        size_t newVertices = 0;
+        for (int k = 0; k < 3; k++)
+            if (remap[triangle[k]] == UINT_MAX && (k == 0 || triangle[k] != triangle[0]) && (k < 2 || triangle[k] != triangle[1]))
+                newVertices++;
+        if (parts.back().vertices.size() + newVertices > maxVertices)
+        {
+            for (unsigned int vertex : used)
+                remap[vertex] = UINT_MAX;
+            used.clear();
+            parts.emplace_back();
+        }
+
+        MeshPart &part = parts.back();
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int vertex = triangle[k];
+            if (remap[vertex] == UINT_MAX)
+            {
+                remap[vertex] = part.vertices.size();
+                part.vertices.push_back(vertices[vertex]);
+                used.push_back(vertex);
+            }
+            part.indices.push_back(remap[vertex]);
+        }
+    }
+    return parts;
+}
+
+struct MeshOptimizationStats {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// runs all passes on a triangle list and reports the vertex cache efficiency before and after
+MeshOptimizationStats OptimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    MeshOptimizationStats stats;
+    stats.before = AnalyzeVertexCache(indices, vertices.size());
+    OptimizeVertexCache(indices, vertices.size());
+    OptimizeOverdraw(indices, vertices);
+    OptimizeVertexFetch(vertices, indices);
+    stats.after = AnalyzeVertexCache(indices, vertices.size());
+    return stats;
+}
+#endif
@@ -0,0 +1,416 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Level of detail generation for imported meshes. Every LOD is a new index list over the mesh's unchanged vertices,
+// made by edge collapses in the order of their quadric error (Garland and Heckbert, "Surface Simplification Using
+// Quadric Error Metrics"). The collapses are half-edge collapses onto an existing vertex, so all LODs share the
+// vertex buffer and only add indices. Vertices on an open border only slide along their border and vertices on an
+// attribute seam (split normals or texture coordinates) only along their seam, anything more complicated stays put.
+
+const unsigned int MESH_LOD_COUNT = 4;              // LODs per mesh, including the full detail one
+const float MESH_LOD_REDUCTION = 0.5f;              // triangle count of a LOD relative to the previous one
+const unsigned int MESH_LOD_MIN_TRIANGLES = 64;     // meshes (and LODs) smaller than this aren't simplified further
+const float MESH_LOD_MAX_ERROR = 0.05f;             // largest error of a LOD, relative to the mesh's bounding box diagonal
+const float MESH_LOD_BORDER_WEIGHT = 10.0f;         // weight of the planes that keep borders and seams in place
+
+// sum of squared distances to a set of planes, weighted by the area the planes came from
+struct Quadric {
+    double a00, a11, a22, a01, a02, a12;    // symmetric 3x3 part
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+// quadric of the plane dot(normal, p) + d = 0, normal has to be unit length
+Quadric PlaneQuadric(const glm::vec3 &normal, float d, double weight)
+{
+    double x = normal.x, y = normal.y, z = normal.z;
+    Quadric q;
+    q.a00 = weight * x * x; q.a11 = weight * y * y; q.a22 = weight * z * z;
+    q.a01 = weight * x * y; q.a02 = weight * x * z; q.a12 = weight * y * z;
+    q.b0 = weight * x * d; q.b1 = weight * y * d; q.b2 = weight * z * d;
+    q.c = weight * d * d;
+    q.weight = weight;
+    return q;
+}
+
+void AddQuadric(Quadric &q, const Quadric &other)
+{
+    q.a00 += other.a00; q.a11 += other.a11; q.a22 += other.a22;
+    q.a01 += other.a01; q.a02 += other.a02; q.a12 += other.a12;
+    q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+// weighted mean of the squared distances from p to the planes of the quadric
+double QuadricError(const Quadric &q, const glm::vec3 &p)
+{
+    if (q.weight <= 0.0)
+        return 0.0;
+    double x = p.x, y = p.y, z = p.z;
+    double error = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+                 + 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+                 + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+    return std::max(error / q.weight, 0.0);
+}
+
+// how a vertex position may move: anywhere on the surface, only along an open border or an attribute seam, or not at all
+enum Simplifier_Vertex_Kind {
+    SIMPLIFY_MANIFOLD,
+    SIMPLIFY_BORDER,
+    SIMPLIFY_SEAM,
+    SIMPLIFY_LOCKED
+};
+
+struct SimplifierPositionKey {
+    float x, y, z;
+    bool operator==(const SimplifierPositionKey &other) const
+    {
+        return memcmp(this, &other, sizeof(*this)) == 0;
+    }
+};
+
+struct SimplifierPositionHash {
+    size_t operator()(const SimplifierPositionKey &key) const
+    {
+        uint32_t bits[3];
+        memcpy(bits, &key, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+struct SimplifierCollapse {
+    unsigned int from, to;
+    float error;    // squared distance
+};
+
+// directed edge a -> b as one sortable key
+uint64_t simplifierEdgeKey(unsigned int a, unsigned int b)
+{
+    return ((uint64_t) a << 32) | b;
+}
+
+bool simplifierHasEdge(const vector<uint64_t> &sortedEdges, unsigned int a, unsigned int b)
+{
+    return std::binary_search(sortedEdges.begin(), sortedEdges.end(), simplifierEdgeKey(a, b));
+}
+
+// simplifies a triangle list towards targetIndexCount indices without making collapses with an error above maxError
+// (in object space units). error receives the largest error of the collapses that were made.
+vector<unsigned int> SimplifyMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                                  size_t targetIndexCount, float maxError, float &error)
+{
+    const unsigned int NONE = UINT_MAX, MULTIPLE = UINT_MAX - 1;
+    size_t vertexCount = vertices.size();
+    error = 0.0f;
+
+    // vertices at the same position (split by normals or texture coordinates) are one position vertex, the first
+    // of them. wedges links the vertices of a position in a ring.
+    vector<unsigned int> positionOf(vertexCount), wedges(vertexCount);
+    {
+        unordered_map<SimplifierPositionKey, unsigned int, SimplifierPositionHash> firstAt;
+        firstAt.reserve(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            SimplifierPositionKey key = {vertices[v].Position.x, vertices[v].Position.y, vertices[v].Position.z};
+            unsigned int first = firstAt.emplace(key, v).first->second;
+            positionOf[v] = first;
+            wedges[v] = first == v ? v : wedges[first];
+            if (first != v)
+                wedges[first] = v;
+        }
+    }
+
+    // the quadrics come from the source triangles only, collapses merge them into the surviving position
+    vector<Quadric> quadrics(vertexCount);
+    memset(quadrics.data(), 0, quadrics.size() * sizeof(Quadric));
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        const glm::vec3 &p0 = vertices[indices[t]].Position, &p1 = vertices[indices[t + 1]].Position, &p2 = vertices[indices[t + 2]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float doubleArea = glm::length(normal);
+        if (doubleArea == 0.0f)
+            continue;
+        normal = normal / doubleArea;
+        Quadric q = PlaneQuadric(normal, -glm::dot(normal, p0), 0.5 * doubleArea);
+        for (int k = 0; k < 3; k++)
+            AddQuadric(quadrics[positionOf[indices[t + k]]], q);
+    }
+    // planes through the open edges, perpendicular to their triangle, keep borders and seams from moving sideways.
+    // seam edges are open from both sides, so their planes go in twice.
+    {
+        vector<uint64_t> edges;
+        for (size_t i = 0; i < indices.size(); i++)
+            edges.push_back(simplifierEdgeKey(indices[i], indices[i % 3 == 2 ? i - 2 : i + 1]));
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            unsigned int a = indices[i], b = indices[i % 3 == 2 ? i - 2 : i + 1];
+            if (simplifierHasEdge(edges, b, a))
+                continue;
+            size_t t = i - i % 3;
+            const glm::vec3 &pa = vertices[a].Position, &pb = vertices[b].Position;
+            glm::vec3 faceNormal = glm::cross(vertices[indices[t + 1]].Position - vertices[indices[t]].Position,
+                                              vertices[indices[t + 2]].Position - vertices[indices[t]].Position);
+            glm::vec3 normal = glm::cross(pb - pa, faceNormal);
+            float length = glm::length(normal);
+            if (length == 0.0f)
+                continue;
+            normal = normal / length;
+            glm::vec3 edge = pb - pa;
+            Quadric q = PlaneQuadric(normal, -glm::dot(normal, pa), MESH_LOD_BORDER_WEIGHT * glm::dot(edge, edge));
+            AddQuadric(quadrics[positionOf[a]], q);
+            AddQuadric(quadrics[positionOf[b]], q);
+        }
+    }
+
+    vector<unsigned int> current(indices);
+    double maxErrorSquared = (double) maxError * maxError;
+    while (current.size() > targetIndexCount)
+    {
+        size_t triangleCount = current.size() / 3;
+
+        // open edges: directed edges without their opposite. an open edge is a border if the opposite is missing
+        // between the positions too, otherwise it lies on a seam.
+        vector<uint64_t> edges, positionEdges;
+        edges.reserve(current.size());
+        positionEdges.reserve(current.size());
+        for (size_t i = 0; i < current.size(); i++)
+        {
+            unsigned int a = current[i], b = current[i % 3 == 2 ? i - 2 : i + 1];
+            edges.push_back(simplifierEdgeKey(a, b));
+            positionEdges.push_back(simplifierEdgeKey(positionOf[a], positionOf[b]));
+        }
+        std::sort(edges.begin(), edges.end());
+        std::sort(positionEdges.begin(), positionEdges.end());
+
+        vector<unsigned int> openOut(vertexCount, NONE), openIn(vertexCount, NONE);
+        vector<bool> used(vertexCount, false), onBorder(vertexCount, false);
+        for (size_t i = 0; i < current.size(); i++)
+        {
+            unsigned int a = current[i], b = current[i % 3 == 2 ? i - 2 : i + 1];
+            used[a] = true;
+            if (simplifierHasEdge(edges, b, a))
+                continue;
+            openOut[a] = openOut[a] == NONE ? b : MULTIPLE;
+            openIn[b] = openIn[b] == NONE ? a : MULTIPLE;
+            if (!simplifierHasEdge(positionEdges, positionOf[b], positionOf[a]))
+                onBorder[a] = onBorder[b] = true;
+        }
+
+        // classify the positions by their wedges that are still in use
+        vector<unsigned char> kinds(vertexCount, SIMPLIFY_LOCKED);
+        for (unsigned int p = 0; p < vertexCount; p++)
+        {
+            if (positionOf[p] != p)
+                continue;
+            unsigned int wedge[3], wedgeCount = 0;
+            unsigned int v = p;
+            do {
+                if (used[v] && wedgeCount < 3)
+                    wedge[wedgeCount++] = v;
+                v = wedges[v];
+            } while (v != p);
+
+            auto single = [&](unsigned int w) { return openOut[w] < MULTIPLE && openIn[w] < MULTIPLE; };
+            if (wedgeCount == 1)
+            {
+                unsigned int w = wedge[0];
+                if (openOut[w] == NONE && openIn[w] == NONE)
+                    kinds[p] = SIMPLIFY_MANIFOLD;
+                else if (single(w) && !simplifierHasEdge(positionEdges, positionOf[openOut[w]], p)
+                         && !simplifierHasEdge(positionEdges, p, positionOf[openIn[w]]))
+                    kinds[p] = SIMPLIFY_BORDER;
+            }
+            else if (wedgeCount == 2 && !onBorder[wedge[0]] && !onBorder[wedge[1]])
+            {
+                unsigned int w0 = wedge[0], w1 = wedge[1];
+                if (single(w0) && single(w1)
+                    && positionOf[openOut[w0]] == positionOf[openIn[w1]] && positionOf[openIn[w0]] == positionOf[openOut[w1]])
+                    kinds[p] = SIMPLIFY_SEAM;
+            }
+        }
+
+        // the other wedge of a seam vertex and the vertex it follows to when v collapses onto target
+        auto seamPartner = [&](unsigned int v, unsigned int target, unsigned int &wedge, unsigned int &wedgeTarget) {
+            wedge = wedges[v];
+            while (wedge == v || !used[wedge])
+                wedge = wedges[wedge];
+            wedgeTarget = openOut[v] == target ? openIn[wedge] : openOut[wedge];
+            return wedgeTarget < MULTIPLE && positionOf[wedgeTarget] == positionOf[target];
+        };
+        auto allowed = [&](unsigned int from, unsigned int to) {
+            if (positionOf[from] == positionOf[to])
+                return false;
+            bool alongOpenEdge = openOut[from] == to || openIn[from] == to;
+            switch (kinds[positionOf[from]])
+            {
+            case SIMPLIFY_MANIFOLD:
+                return true;
+            case SIMPLIFY_BORDER:
+                return alongOpenEdge;
+            case SIMPLIFY_SEAM:
+            {
+                unsigned int wedge, wedgeTarget;
+                return alongOpenEdge && seamPartner(from, to, wedge, wedgeTarget);
+            }
+            default:
+                return false;
+            }
+        };
+
+        vector<SimplifierCollapse> collapses;
+        for (size_t i = 0; i < current.size(); i++)
+        {
+            unsigned int a = current[i], b = current[i % 3 == 2 ? i - 2 : i + 1];
+            if (allowed(a, b))
+                collapses.push_back({a, b, (float) QuadricError(quadrics[positionOf[a]], vertices[b].Position)});
+            if (allowed(b, a))
+                collapses.push_back({b, a, (float) QuadricError(quadrics[positionOf[b]], vertices[a].Position)});
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const SimplifierCollapse &x, const SimplifierCollapse &y) { return x.error < y.error; });
+
+        // triangles around every position, for the flip test
+        vector<unsigned int> firstTriangle(vertexCount + 1, 0), triangles(current.size());
+        for (unsigned int index : current)
+            firstTriangle[positionOf[index] + 1]++;
+        for (size_t p = 0; p < vertexCount; p++)
+            firstTriangle[p + 1] += firstTriangle[p];
+        {
+            vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+            for (size_t i = 0; i < current.size(); i++)
+                triangles[fill[positionOf[current[i]]]++] = i / 3;
+        }
+
+        vector<unsigned int> remap(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        // would moving position from onto target turn any of its remaining triangles around
+        auto flips = [&](unsigned int from, unsigned int target) {
+            unsigned int position = positionOf[from];
+            const glm::vec3 &moved = vertices[target].Position;
+            for (unsigned int j = firstTriangle[position]; j < firstTriangle[position + 1]; j++)
+            {
+                const unsigned int *triangle = &current[3 * triangles[j]];
+                glm::vec3 corners[3], after[3];
+                bool collapses = false;
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int v = remap[triangle[k]];
+                    corners[k] = after[k] = vertices[v].Position;
+                    if (positionOf[v] == positionOf[target])
+                        collapses = true;
+                    if (positionOf[v] == position)
+                        after[k] = moved;
+                }
+                if (collapses)
+                    continue;   // the triangle degenerates and is removed
+                glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                glm::vec3 now = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(before, now) <= 0.0f)
+                    return true;
+            }
+            return false;
+        };
+
+        // every collapse removes about two triangles. positions touched by a collapse are locked for the rest of
+        // the pass, so the quadrics and adjacency stay valid. collapses much worse than the ones needed to reach the
+        // goal wait for the next pass, which may find cheaper ones around the vertices collapsed in this one.
+        size_t goal = std::max<size_t>((triangleCount - targetIndexCount / 3) / 2, 1);
+        if (collapses.empty())
+            break;
+        double passLimit = std::min(maxErrorSquared, 1.5 * collapses[std::min(goal, collapses.size()) - 1].error);
+        size_t collapsed = 0;
+        vector<bool> locked(vertexCount, false);
+        for (const SimplifierCollapse &collapse : collapses)
+        {
+            if (collapsed >= goal || (collapse.error > passLimit && collapsed > 0) || collapse.error > maxErrorSquared)
+                break;
+            unsigned int from = collapse.from, to = collapse.to;
+            unsigned int fromPosition = positionOf[from], toPosition = positionOf[to];
+            if (locked[fromPosition] || locked[toPosition] || flips(from, to))
+                continue;
+
+            remap[from] = to;
+            if (kinds[fromPosition] == SIMPLIFY_SEAM)
+            {
+                unsigned int wedge, wedgeTarget;
+                seamPartner(from, to, wedge, wedgeTarget);
+                remap[wedge] = wedgeTarget;
+            }
+            locked[fromPosition] = locked[toPosition] = true;
+            AddQuadric(quadrics[toPosition], quadrics[fromPosition]);
+            error = std::max(error, collapse.error);
+            collapsed++;
+        }
+        if (collapsed == 0)
+            break;
+
+        vector<unsigned int> simplified;
+        simplified.reserve(current.size());
+        for (size_t t = 0; t + 2 < current.size(); t += 3)
+        {
+            unsigned int a = remap[current[t]], b = remap[current[t + 1]], c = remap[current[t + 2]];
+            if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c])
+                continue;
+            simplified.push_back(a);
+            simplified.push_back(b);
+            simplified.push_back(c);
+        }
+        current.swap(simplified);
+    }
+    error = std::sqrt(error);
+    return current;
+}
+
+// appends the LODs of an optimized triangle mesh to its index list and returns the LOD table, LOD 0 being the
+// original list. every LOD is simplified from the previous one and reordered for the vertex cache; the chain stops
+// early when a mesh doesn't simplify any further within MESH_LOD_MAX_ERROR.
+vector<MeshLod> GenerateLods(const vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    vector<MeshLod> lods(1, MeshLod{0, (uint32_t) indices.size(), 0.0f});
+    if (indices.empty())
+        return lods;
+
+    glm::vec3 lo = vertices[indices[0]].Position, hi = lo;
+    for (unsigned int index : indices)
+    {
+        lo = glm::min(lo, vertices[index].Position);
+        hi = glm::max(hi, vertices[index].Position);
+    }
+    float maxError = MESH_LOD_MAX_ERROR * glm::length(hi - lo);
+
+    vector<unsigned int> source(indices);
+    float error = 0.0f;
+    while (lods.size() < MESH_LOD_COUNT && source.size() / 3 >= MESH_LOD_MIN_TRIANGLES)
+    {
+        size_t target = (size_t) (source.size() / 3 * MESH_LOD_REDUCTION) * 3;
+        float lodError;
+        vector<unsigned int> lod = SimplifyMesh(vertices, source, target, maxError - error, lodError);
+        if (lod.empty() || lod.size() > source.size() * 0.85)
+            break;      // hardly anything left to collapse
+        error += lodError;  // measured against the previous LOD, so the errors add up
+        OptimizeVertexCache(lod, vertices.size());
+        lods.push_back(MeshLod{(uint32_t) indices.size(), (uint32_t) lod.size(), error});
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        source.swap(lod);
+    }
+    return lods;
+}
+#endif
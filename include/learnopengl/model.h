@@ -10,20 +10,93 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/frustum.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/texture_loader.h>
 
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <thread>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <iomanip>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// post processing steps used for every import. They are part of the mesh cache key, so changing them invalidates cached models.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
+// what the material texture types hold, for picking their compressed format
+Texture_Usage TextureUsageForType(const string &typeName)
+{
+    if (typeName == "texture_normal")
+        return USAGE_NORMAL;
+    if (typeName == "texture_specular" || typeName == "texture_height")
+        return USAGE_SCALAR;
+    return USAGE_COLOR;
+}
+
+// the camera LOD selection and frustum culling work against, set once per frame with SetLodView (and SetCullingView)
+// before the models are drawn
+struct LodView {
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float pixelsPerUnit = 0.0f;     // pixels covered by one world unit at distance one, 0 draws everything at LOD 0
+    float maxPixelError = 1.0f;     // how many pixels a LOD may be off on screen
+    unsigned int frame = 0;
+    bool culling = false;           // drop the meshes outside of the frustum of viewProjection
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+};
+
+LodView &CurrentLodView()
+{
+    static LodView view;
+    return view;
+}
+
+// fovy is the vertical field of view in radians (the camera's Zoom), viewportHeight in pixels
+void SetLodView(const glm::vec3 &cameraPosition, float fovy, float viewportHeight, float maxPixelError)
+{
+    LodView &view = CurrentLodView();
+    view.cameraPosition = cameraPosition;
+    view.pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovy / 2.0f));
+    view.maxPixelError = maxPixelError;
+    view.frame++;
+}
+
+// turns on frustum culling against projection * view for the models drawn from now on
+void SetCullingView(const glm::mat4 &viewProjection)
+{
+    LodView &view = CurrentLodView();
+    view.culling = true;
+    view.viewProjection = viewProjection;
+}
+
+// the largest axis scale of a model matrix, turns object space sizes into world space ones
+float MaxAxisScale(const glm::mat4 &model)
+{
+    return std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+}
+
+// how a model gets loaded: completely inside the constructor, or imported on a background thread and uploaded
+// to the GPU over several frames by a ModelStreamer
+enum Model_Loading {
+    LOAD_BLOCKING,
+    LOAD_ASYNC
+};
 
 class Model
 {
@@ -33,43 +106,638 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // load statistics, filled in by the constructor
+    bool loadedFromCache = false;
+    double meshLoadMilliseconds = 0.0;
+    double textureLoadMilliseconds = 0.0;
+    // object space bounding box and sphere around all meshes, valid once the model is loaded
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f), boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // with LOAD_ASYNC the constructor returns right away; the import runs on a background thread and the model has to
+    // be handed to a ModelStreamer, which uploads it piece by piece. until then Draw skips the meshes that aren't resident.
+    // vertexFormat selects the GPU vertex layout of the meshes, see PackedVertex.
+    Model(string const &path, bool gamma = false, Model_Loading loading = LOAD_BLOCKING, Vertex_Format vertexFormat = VERTEX_FULL)
+        : gammaCorrection(gamma), async(loading == LOAD_ASYNC), vertexFormat(vertexFormat)
     {
-        loadModel(path);
+        loadStart = chrono::steady_clock::now();
+        if (async)
+            loader = std::thread(&Model::importAsync, this, path);
+        else
+            loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
+    // deletes the model's buffers and vertex arrays and gives its references on its textures back to the texture
+    // cache. has to run while the GL context is current.
+    ~Model()
+    {
+        if (loader.joinable())
+            loader.join();
+        for (unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            unsigned int id = textures_loaded[i].id;
+            if (!streamingFinished && i < streamedTextures.size())
+            {
+                const StreamedImage &streamed = streamedTextures[i];
+                id = streamed.done ? streamed.id : 0;
+                // loaders waiting for this model's upload load the texture themselves. a texture StreamImage already
+                // created isn't in the cache yet, so it is deleted here.
+                if (!streamed.done && !streamed.shared)
+                {
+                    TextureCache::Instance().Abandon(textureKeys[i]);
+                    if (streamed.id != 0)
+                        glDeleteTextures(1, &streamed.id);
+                }
+            }
+            if (id != 0)
+                TextureCache::Instance().Release(id);
+        }
+        if (!textureArrays.empty())
+            glDeleteTextures(textureArrays.size(), textureArrays.data());
+        for (const InstanceSet &set : instanceSets)
+        {
+            glDeleteVertexArrays(1, &set.VAO);
+            glDeleteBuffers(1, &set.VBO);
+        }
+        glDeleteVertexArrays(1, &indirectVAO);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+
+    // the loader thread works on this object, so it can't be copied or moved
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    // draws the model, and thus all its meshes, at full detail
     void Draw(Shader &shader)
     {
+        if (!importFinished || VAO == 0)
+            return;     // the loader thread is still filling in the meshes
+        glBindVertexArray(VAO);
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            if (meshes[i].resident)
+                meshes[i].Draw(shader);
+        glBindVertexArray(0);
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+    // draws the model with the given model matrix, every mesh at the LOD its projected size on screen asks for (see
+    // SetLodView) and only if it is inside the view frustum (see SetCullingView). a model drawn several times a frame
+    // keeps the LOD state of every instance by the order of the draws.
+    void Draw(Shader &shader, const glm::mat4 &model)
+    {
+        if (!importFinished || VAO == 0)
+            return;
+        vector<unsigned char> &lods = selectLods(model);
+        const vector<unsigned char> &visible = cullMeshes(model);
+        glBindVertexArray(VAO);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            if (visible[i])
+                meshes[i].Draw(shader, lods[i]);
+        glBindVertexArray(0);
+    }
+
+    // like Draw, but queues every mesh as a draw of the given layer; the queue sets the model matrix in modelUniform.
+    // with multi-draw indirect available the meshes are queued as indirect draws, on a second VAO that reads the
+    // model matrix per draw (see IndirectDrawBuffers).
+    void Submit(RenderQueue &queue, Render_Layer layer, Shader &shader, UniformLocation modelUniform, const glm::mat4 &model)
+    {
+        if (!importFinished || VAO == 0)
+            return;
+        if (IndirectDrawingSupported() && indirectVAO == 0)
+            createIndirectVAO();
+        bool indirect = indirectVAO != 0;
+        vector<unsigned char> &lods = selectLods(model);
+        const vector<unsigned char> &visible = cullMeshes(model);
+        unsigned int instance = queue.NextInstance();
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            if (!visible[i])
+                continue;
+            glm::vec3 center = glm::vec3(model * glm::vec4(mesh.BoundsCenter(), 1.0f));
+            queue.SubmitMesh(layer, shader, modelUniform, model, instance, indirect ? indirectVAO : VAO, mesh, lods[i], center, 1, indirect);
         }
     }
+
+    // draws all the given copies of the model with one instanced draw per mesh. the matrices go to an instance buffer
+    // the vertex shader reads at INSTANCE_MATRIX_LOCATION, modelUniform is set to the identity. every mesh uses the LOD
+    // its closest copy needs. copies whose bounding sphere is outside the view frustum are left out. like the LOD
+    // state, the instance buffers are kept per call by the order of the calls in a frame; a buffer is only rewritten
+    // when its matrices change, so static copies cost no uploads.
+    void SubmitInstanced(RenderQueue &queue, Render_Layer layer, Shader &shader, UniformLocation modelUniform, const vector<glm::mat4> &models)
+    {
+        if (!importFinished || VAO == 0)
+            return;
+        const LodView &view = CurrentLodView();
+        Frustum frustum = FrustumFromMatrix(view.viewProjection);
+        visibleInstances.clear();
+        for (const glm::mat4 &model : models)
+            if (!view.culling || SphereInFrustum(frustum, glm::vec3(model * glm::vec4(boundsCenter, 1.0f)), boundsRadius * MaxAxisScale(model)))
+                visibleInstances.push_back(model);
+        unsigned int residentMeshes = 0;
+        for (const Mesh &mesh : meshes)
+            residentMeshes += mesh.resident;
+        RenderStats &stats = FrameStats();
+        stats.meshesVisible += residentMeshes * visibleInstances.size();
+        stats.meshesCulled += residentMeshes * (models.size() - visibleInstances.size());
+        if (visibleInstances.empty())
+            return;
+
+        vector<unsigned char> &lods = selectLods(visibleInstances.data(), visibleInstances.size());
+        InstanceSet &set = nextInstanceSet(visibleInstances);
+        unsigned int instance = queue.NextInstance();
+        glm::vec3 middle(0.0f);
+        for (const glm::mat4 &model : visibleInstances)
+            middle += glm::vec3(model[3]) / (float) visibleInstances.size();
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            if (mesh.resident)
+                queue.SubmitMesh(layer, shader, modelUniform, glm::mat4(1.0f), instance, set.VAO, mesh, lods[i], middle, visibleInstances.size());
+        }
+    }
+
+    // uploads the next part of an asynchronously loaded model: mesh by mesh, first its buffers then its textures, so
+    // every mesh becomes drawable as soon as all of its data is on the GPU. uploads at most byteBudget bytes (a single
+    // texture row may go over it) and returns the number of bytes uploaded. must run on the GL thread.
+    size_t StreamUploads(size_t byteBudget, unsigned int pbo)
+    {
+        if (!importFinished || streamingFinished)
+            return 0;
+        if (VAO == 0)
+            createBuffers();
+
+        size_t uploaded = 0;
+        bool waitingForShared = false;
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        while (nextStreamedMesh < meshes.size() && uploaded < byteBudget)
+        {
+            Mesh &mesh = meshes[nextStreamedMesh];
+            uploaded += uploadMesh(nextStreamedMesh, byteBudget - uploaded);
+            if (!mesh.IsUploaded())
+                break;
+
+            bool texturesDone = true;
+            for (Texture &texture : mesh.textures)
+            {
+                unsigned int index = textureIndices[texture.path];
+                StreamedImage &streamed = streamedTextures[index];
+                if (!streamed.done && streamed.shared)
+                    waitingForShared = !takeSharedTexture(index);
+                else if (!streamed.done && uploaded < byteBudget)
+                    uploaded += streamTexture(index, pbo, byteBudget - uploaded);
+                if (!streamed.done)
+                {
+                    texturesDone = false;
+                    break;
+                }
+                texture.id = streamed.id;
+            }
+            if (!texturesDone)
+                break;
+            mesh.ResolveTextureBindings();
+            mesh.resident = true;
+            nextStreamedMesh++;
+        }
+        glBindVertexArray(0);
+        // while a mesh waits for a texture another model uploads, this model's own textures go ahead, that model may
+        // just as well be waiting for one of them
+        if (waitingForShared)
+        {
+            for (unsigned int i = 0; i < streamedTextures.size() && uploaded < byteBudget; i++)
+            {
+                if (!streamedTextures[i].done && !streamedTextures[i].shared)
+                    uploaded += streamTexture(i, pbo, byteBudget - uploaded);
+            }
+        }
+
+        if (nextStreamedMesh == meshes.size())
+        {
+            cacheFile.reset();
+            for (unsigned int i = 0; i < textures_loaded.size(); i++)
+                textures_loaded[i].id = streamedTextures[i].id;
+            streamedTextures.clear();
+            buildTextureArrays();
+            streamingFinished = true;
+            cout << "Model " << sourcePath << " resident after "
+                 << chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count() << " ms" << endl;
+        }
+        return uploaded;
+    }
+
+    // uploads the next part of one of the model's own streamed textures, handing it to the texture cache once it is
+    // complete
+    size_t streamTexture(unsigned int index, unsigned int pbo, size_t byteBudget)
+    {
+        StreamedImage &streamed = streamedTextures[index];
+        size_t uploaded = StreamImage(streamed, pbo, byteBudget);
+        if (streamed.done)
+            streamed.id = TextureCache::Instance().Insert(textureKeys[index], streamed.id);
+        return uploaded;
+    }
+
+    // picks up a texture another loader claimed, once it is in the texture cache. returns whether it was there.
+    bool takeSharedTexture(unsigned int index)
+    {
+        StreamedImage &streamed = streamedTextures[index];
+        TextureCache &cache = TextureCache::Instance();
+        unsigned int id = cache.Acquire(textureKeys[index]);
+        if (id == 0 && !cache.Pending(textureKeys[index]))
+            id = cache.Load(textureKeys[index]);   // its loader gave up on it
+        if (id == 0)
+            return false;
+        streamed.id = id;
+        streamed.done = true;
+        return true;
+    }
+
+    // true once the model is imported and all of its meshes are resident
+    bool IsLoaded() const
+    {
+        return importFinished && streamingFinished;
+    }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    bool async;
+    Vertex_Format vertexFormat;
+    string sourcePath;
+    chrono::steady_clock::time_point loadStart;
+    // shared geometry of all meshes
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int indirectVAO = 0;   // the same buffers with the draw data of the multi-draw path, see Submit
+    size_t vertexBufferBytes = 0, indexBufferBytes = 0;
+    // mapped mesh cache the meshes are uploaded from, until they are all resident (reset in StreamUploads/loadModel)
+    std::unique_ptr<MeshCacheFile> cacheFile;
+    // async loading state
+    std::thread loader;
+    std::atomic<bool> importFinished{false};    // set by the loader thread once meshes and textures_loaded are complete
+    bool streamingFinished = false;
+    unsigned int nextStreamedMesh = 0;
+    vector<StreamedImage> streamedTextures;     // decoded images, same order as textures_loaded
+    // texture lookup
+    unordered_map<string, unsigned int> textureIndices;    // material texture path -> index into textures_loaded
+    vector<TextureKey> textureKeys;                         // texture cache keys, same order as textures_loaded
+    vector<unsigned int> textureArrays;                     // see buildTextureArrays
+    // LOD selection state: the current LOD of every mesh for every instance drawn in a frame
+    vector<vector<unsigned char>> lodStates;
+    unsigned int lodFrame = 0, lodInstance = 0;
+    // instanced draws: a VAO over the model's buffers plus an instance buffer for every SubmitInstanced call in a frame
+    struct InstanceSet {
+        unsigned int VAO = 0, VBO = 0;
+        vector<glm::mat4> matrices;     // what the instance buffer holds
+    };
+    vector<InstanceSet> instanceSets;
+    unsigned int instanceSetFrame = 0, instanceSetCount = 0;
+    vector<glm::mat4> visibleInstances;
+    // frustum culling: the box of every mesh for the batch test
+    BoxBatch meshBoxes;
+    vector<unsigned char> meshVisible;
+
+    // marks the resident meshes inside the view frustum (see SetCullingView) for the given model matrix and counts
+    // them in the frame stats. the frustum is taken into object space, so the model's bounding sphere and the boxes
+    // of the meshes are tested as they are: the sphere first, the boxes four at a time with CullBoxes.
+    const vector<unsigned char> &cullMeshes(const glm::mat4 &model)
+    {
+        const LodView &view = CurrentLodView();
+        meshVisible.assign(meshes.size(), 1);
+        if (view.culling && meshBoxes.Size() == meshes.size())
+        {
+            Frustum frustum = FrustumFromMatrix(view.viewProjection * model);
+            if (SphereInFrustum(frustum, boundsCenter, boundsRadius))
+                CullBoxes(frustum, meshBoxes, meshVisible.data());
+            else
+                meshVisible.assign(meshes.size(), 0);
+        }
+        RenderStats &stats = FrameStats();
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (!meshes[i].resident)
+                meshVisible[i] = 0;
+            else if (meshVisible[i])
+                stats.meshesVisible++;
+            else
+                stats.meshesCulled++;
+        }
+        return meshVisible;
+    }
+
+    // collects the mesh bounds for culling, once all meshes are loaded
+    void computeModelBounds()
+    {
+        meshBoxes = BoxBatch();
+        if (meshes.empty())
+            return;
+        boundsMin = meshes[0].boundsMin;
+        boundsMax = meshes[0].boundsMax;
+        for (const Mesh &mesh : meshes)
+        {
+            meshBoxes.Add(mesh.boundsMin, mesh.boundsMax);
+            boundsMin = glm::min(boundsMin, mesh.boundsMin);
+            boundsMax = glm::max(boundsMax, mesh.boundsMax);
+        }
+        boundsCenter = (boundsMin + boundsMax) * 0.5f;
+        boundsRadius = 0.0f;
+        for (const Mesh &mesh : meshes)
+            boundsRadius = std::max(boundsRadius, glm::length(mesh.BoundsCenter() - boundsCenter) + mesh.boundsRadius);
+    }
+
+    // picks the LOD of every resident mesh for the next instance drawn this frame with the given model matrix
+    vector<unsigned char> &selectLods(const glm::mat4 &model)
+    {
+        return selectLods(&model, 1);
+    }
+
+    // the same for several copies drawn together: every mesh gets the LOD the closest copy needs
+    vector<unsigned char> &selectLods(const glm::mat4 *models, size_t count)
+    {
+        const LodView &view = CurrentLodView();
+        if (lodFrame != view.frame)
+        {
+            lodFrame = view.frame;
+            lodInstance = 0;
+        }
+        if (lodInstance == lodStates.size())
+            lodStates.push_back(vector<unsigned char>(meshes.size(), 0));
+        vector<unsigned char> &state = lodStates[lodInstance++];
+
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const Mesh &mesh = meshes[i];
+            if (!mesh.resident)
+                continue;
+            float pixelsPerUnit = 0.0f;
+            for (size_t j = 0; j < count; j++)
+            {
+                const glm::mat4 &model = models[j];
+                float scale = MaxAxisScale(model);
+                glm::vec3 center = glm::vec3(model * glm::vec4(mesh.BoundsCenter(), 1.0f));
+                float radius = mesh.boundsRadius * scale;
+                // distance to the closest point of the bounding sphere, inside it the mesh is as close as it gets
+                float distance = std::max(glm::length(center - view.cameraPosition) - radius, 0.01f);
+                pixelsPerUnit = std::max(pixelsPerUnit, view.pixelsPerUnit * scale / distance);
+            }
+            state[i] = SelectLod(mesh.lods, state[i], pixelsPerUnit, view.maxPixelError);
+        }
+        return state;
+    }
+
+    // the instance set of the next SubmitInstanced call this frame, holding the given matrices
+    InstanceSet &nextInstanceSet(const vector<glm::mat4> &models)
+    {
+        unsigned int frame = CurrentLodView().frame;
+        if (instanceSetFrame != frame)
+        {
+            instanceSetFrame = frame;
+            instanceSetCount = 0;
+        }
+        if (instanceSetCount == instanceSets.size())
+            instanceSets.push_back(InstanceSet());
+        InstanceSet &set = instanceSets[instanceSetCount++];
+
+        if (set.VAO == 0)
+        {
+            glGenVertexArrays(1, &set.VAO);
+            glGenBuffers(1, &set.VBO);
+            glBindVertexArray(set.VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            SetupVertexAttributes(vertexFormat);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBindBuffer(GL_ARRAY_BUFFER, set.VBO);
+            SetupInstanceAttributes();
+            glBindVertexArray(0);
+        }
+        if (set.matrices != models)
+        {
+            set.matrices = models;
+            glBindBuffer(GL_ARRAY_BUFFER, set.VBO);
+            glBufferData(GL_ARRAY_BUFFER, models.size() * sizeof(glm::mat4), models.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        return set;
+    }
+
+    // runs on the loader thread: imports the meshes (without touching GL) and decodes their textures
+    void importAsync(string path)
+    {
+        sourcePath = path;
+        directory = path.substr(0, path.find_last_of('/'));
+        importMeshes(path);
+
+        auto textureStart = chrono::steady_clock::now();
+        vector<unsigned int> missing, shared;
+        vector<ImageData> images = acquireCachedTextures(missing, &shared);
+        DecodeImagesParallel(images);
+        streamedTextures.resize(textures_loaded.size());
+        for (unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            streamedTextures[i].id = textures_loaded[i].id;
+            streamedTextures[i].done = textures_loaded[i].id != 0;
+        }
+        for (unsigned int i = 0; i < missing.size(); i++)
+            streamedTextures[missing[i]].image = images[i];
+        for (unsigned int index : shared)
+            streamedTextures[index].shared = true;
+        textureLoadMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - textureStart).count();
+
+        importFinished = true;
+    }
+
+    // looks all collected textures up in the global texture cache, taking a reference on the ones that are already
+    // loaded (by this or any other model) and claiming the others. returns the images that still have to be decoded,
+    // missing receives their indices into textures_loaded. the textures another loader claimed first go to shared,
+    // without shared (on the GL thread, which can't wait for them) they are decoded here as well.
+    vector<ImageData> acquireCachedTextures(vector<unsigned int> &missing, vector<unsigned int> *shared = nullptr)
+    {
+        vector<ImageData> images;
+        textureKeys.clear();
+        for (unsigned int i = 0; i < textures_loaded.size(); i++)
+        {
+            textureKeys.push_back(MakeTextureKey(directory + '/' + textures_loaded[i].path, COLORSPACE_LINEAR, WRAP_REPEAT,
+                                                 TextureUsageForType(textures_loaded[i].type)));
+            bool claimed;
+            textures_loaded[i].id = TextureCache::Instance().Claim(textureKeys[i], claimed);
+            if (textures_loaded[i].id != 0)
+                continue;
+            if (!claimed && shared)
+            {
+                shared->push_back(i);
+                continue;
+            }
+            images.push_back(TextureCache::Instance().MakeImage(textureKeys[i]));
+            missing.push_back(i);
+        }
+        return images;
+    }
+
+    // loads a model from its mesh cache if there is a valid one, otherwise with ASSIMP (and writes the cache for the next start).
+    // the resulting meshes are stored in the meshes vector.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
+        sourcePath = path;
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        importMeshes(path);
+        createBuffers();
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            uploadMesh(i, SIZE_MAX);
+            meshes[i].resident = true;
+        }
+        glBindVertexArray(0);
+        cacheFile.reset();
+        loadPendingTextures();
+        buildTextureArrays();
+        importFinished = true;
+        streamingFinished = true;
+    }
+
+    // fills in the meshes from the mesh cache or from ASSIMP and reports how long that took
+    void importMeshes(string const &path)
+    {
+        auto start = chrono::steady_clock::now();
+        loadedFromCache = loadCachedModel(path);
+        if (!loadedFromCache && importModel(path))
+        {
+            if (!WriteMeshCache(path, MODEL_IMPORT_FLAGS, meshes))
+                cout << "WARNING::MESH_CACHE:: could not write cache for " << path << endl;
+        }
+        layoutMeshes();
+        computeModelBounds();
+        meshLoadMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        size_t vertexCount = 0, indexCount = 0, shortIndexMeshes = 0, indexBytes = 0;
+        vector<size_t> lodTriangles;
+        for (const Mesh &mesh : meshes)
+        {
+            vertexCount += mesh.vertexCount;
+            indexCount += mesh.indexCount;
+            indexBytes += mesh.IndexBufferBytes();
+            shortIndexMeshes += mesh.indexType == GL_UNSIGNED_SHORT;
+            // meshes with a shorter LOD chain count with their last LOD
+            for (unsigned int lod = 0; lod < MESH_LOD_COUNT; lod++)
+            {
+                if (lodTriangles.size() <= lod)
+                    lodTriangles.push_back(0);
+                lodTriangles[lod] += mesh.lods[std::min<size_t>(lod, mesh.lods.size() - 1)].indexCount / 3;
+            }
+        }
+        string lodReport;
+        for (size_t triangles : lodTriangles)
+            lodReport += (lodReport.empty() ? "" : "/") + to_string(triangles);
+        auto kilobytes = [](size_t bytes) { return to_string(bytes / 1024) + " KB"; };
+        cout << ("Model " + path + (loadedFromCache ? " (warm, mesh cache)" : " (cold, assimp)") + ": "
+                 + to_string(meshes.size()) + " meshes in " + to_string(meshLoadMilliseconds) + " ms, "
+                 + to_string(vertexCount) + " vertices at " + to_string(VertexStride(vertexFormat)) + " bytes (full "
+                 + to_string(sizeof(Vertex)) + "), VBO " + kilobytes(vertexCount * VertexStride(vertexFormat)) + " (full "
+                 + kilobytes(vertexCount * sizeof(Vertex)) + "), EBO " + kilobytes(indexBytes) + " (32 bit "
+                 + kilobytes(indexCount * sizeof(unsigned int)) + ", " + to_string(shortIndexMeshes) + " meshes with 16 bit indices), "
+                 + "LOD triangles " + lodReport + "\n") << flush;
+    }
+
+    // maps the mesh cache file of the model, returns false if there is no valid cache. the mapping stays open until
+    // the meshes are uploaded, they are copied straight from it into the GPU buffers.
+    bool loadCachedModel(string const &path)
+    {
+        std::unique_ptr<MeshCacheFile> cache(new MeshCacheFile());
+        if (!cache->Open(path, MODEL_IMPORT_FLAGS))
+            return false;
+
+        for (const CachedMesh &cached : cache->meshes)
+        {
+            vector<Texture> textures;
+            for (const Texture &ref : cached.textures)
+                textures.push_back(loadTexture(ref.path.c_str(), ref.type));
+            meshes.push_back(Mesh(cached.vertexCount, cached.indexCount, textures, vertexFormat));
+            meshes.back().lods = cached.lods;
+            meshes.back().boundsMin = cached.boundsMin;
+            meshes.back().boundsMax = cached.boundsMax;
+            meshes.back().boundsRadius = cached.boundsRadius;
+        }
+        cacheFile = std::move(cache);
+        return true;
+    }
+
+    // places all meshes back to back in one vertex and one index buffer. index ranges are aligned to their index size.
+    void layoutMeshes()
+    {
+        unsigned int vertexTotal = 0;
+        size_t indexBytes = 0;
+        for (Mesh &mesh : meshes)
+        {
+            mesh.baseVertex = vertexTotal;
+            vertexTotal += mesh.vertexCount;
+            size_t indexSize = IndexSize(mesh.indexType);
+            indexBytes = (indexBytes + indexSize - 1) / indexSize * indexSize;
+            mesh.indexOffset = indexBytes;
+            indexBytes += mesh.IndexBufferBytes();
+        }
+        vertexBufferBytes = (size_t) vertexTotal * VertexStride(vertexFormat);
+        indexBufferBytes = indexBytes;
+    }
+
+    // creates the model's VAO and allocates the shared buffers laid out by layoutMeshes. must run on the GL thread.
+    void createBuffers()
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertexBufferBytes, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferBytes, nullptr, GL_STATIC_DRAW);
+        SetupVertexAttributes(vertexFormat);
+        glBindVertexArray(0);
+        SetDefaultInstanceMatrix();
+    }
+
+    // a VAO over the model's buffers whose instance matrix comes from the multi-draw draw data
+    void createIndirectVAO()
+    {
+        glGenVertexArrays(1, &indirectVAO);
+        glBindVertexArray(indirectVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        SetupVertexAttributes(vertexFormat);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindVertexArray(0);
+        IndirectBuffers().Attach(indirectVAO);
+    }
+
+    // the import layout vertices of a mesh, from the mapped cache or from its own arrays
+    const Vertex *meshVertices(unsigned int index) const
+    {
+        return cacheFile ? cacheFile->meshes[index].vertices : meshes[index].vertices.data();
+    }
+
+    // uploads the next part of a mesh from the mapped cache or from its own arrays, see Mesh::Upload
+    size_t uploadMesh(unsigned int index, size_t byteBudget)
+    {
+        Mesh &mesh = meshes[index];
+        const unsigned int *indexData = cacheFile ? cacheFile->meshes[index].indices : mesh.indices.data();
+        return mesh.Upload(byteBudget, meshVertices(index), indexData);
+    }
+
+    // read file via ASSIMP
+    bool importModel(string const &path)
+    {
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -81,7 +749,8 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            vector<Mesh> parts = processMesh(mesh, scene);
+            meshes.insert(meshes.end(), parts.begin(), parts.end());
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
@@ -91,7 +760,8 @@ private:
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // converts an ASSIMP mesh; meshes with more vertices than 16 bit indices can address come back in several parts
+    vector<Mesh> processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
         vector<Vertex> vertices;
@@ -144,13 +814,25 @@ private:
 
         }
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        bool triangles = true;
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
             aiFace face = mesh->mFaces[i];
+            triangles = triangles && face.mNumIndices == 3;
             // retrieve all indices of the face and store them in the indices vector
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
+        // reorder triangles and vertices for the GPU (point and line meshes are left as they are)
+        if (triangles)
+        {
+            MeshOptimizationStats stats = OptimizeMesh(vertices, indices);
+            std::stringstream report;
+            report << std::fixed << std::setprecision(3) << "Model " << sourcePath << " mesh " << meshes.size() << ": "
+                   << indices.size() / 3 << " triangles, ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+                   << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << "\n";
+            cout << report.str() << flush;
+        }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -178,8 +860,24 @@ private:
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the mesh objects created from the extracted mesh data, triangle meshes with their LOD chain
+        vector<MeshPart> split;
+        if (triangles && vertices.size() > SHORT_INDEX_VERTEX_LIMIT)
+            split = SplitMesh(vertices, indices, SHORT_INDEX_VERTEX_LIMIT);
+        else
+            split.push_back(MeshPart{vertices, indices});
+        vector<Mesh> parts;
+        for (MeshPart &part : split)
+        {
+            vector<MeshLod> lods;
+            if (triangles)
+                lods = GenerateLods(part.vertices, part.indices);
+            parts.push_back(Mesh(part.vertices, part.indices, textures, vertexFormat));
+            if (!lods.empty())
+                parts.back().lods = lods;
+            parts.back().ComputeBounds(parts.back().vertices.data());
+        }
+        return parts;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -191,69 +889,100 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(loadTexture(str.C_Str(), typeName));
         }
         return textures;
     }
-};
-
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // collects a single material texture, unless a texture with the same filepath was collected before.
+    // the texture isn't loaded yet: its id stays 0 until loadPendingTextures decodes and uploads all of them at once.
+    Texture loadTexture(const char *path, const string &typeName)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // check if texture was loaded before and if so skip loading a new texture
+        auto loaded = textureIndices.find(path);
+        if (loaded != textureIndices.end())
+            return textures_loaded[loaded->second]; // a texture with the same filepath has already been loaded (optimization)
+        // if texture hasn't been loaded already, queue it
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = path;
+        textureIndices[texture.path] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
+    }
 
-        stbi_image_free(data);
+    // decodes all textures collected while processing the meshes that aren't in the texture cache yet on every core,
+    // then uploads them on the GL thread and patches the resulting ids into the meshes
+    void loadPendingTextures()
+    {
+        auto start = chrono::steady_clock::now();
+        vector<unsigned int> missing;
+        vector<ImageData> images = acquireCachedTextures(missing);
+        DecodeImagesParallel(images);
+
+        for (unsigned int i = 0; i < missing.size(); i++)
+            textures_loaded[missing[i]].id = TextureCache::Instance().Insert(textureKeys[missing[i]], UploadImage(images[i]));
+        for (Mesh &mesh : meshes)
+        {
+            for (Texture &texture : mesh.textures)
+                texture.id = textures_loaded[textureIndices[texture.path]].id;
+            mesh.ResolveTextureBindings();
+        }
+        textureLoadMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "Model " << directory << ": " << textures_loaded.size() << " textures (" << missing.size() << " decoded) in "
+             << textureLoadMilliseconds << " ms" << endl;
     }
-    else
+
+    // with UseTextureArrays, copies the finished textures into texture arrays and rebinds the meshes to them, so
+    // meshes with different textures of the same format can be drawn together. the 2D textures no mesh binds anymore
+    // go back to the texture cache. textures other users hold as well stay 2D, an array copy per model would undo the
+    // sharing of the cache.
+    void buildTextureArrays()
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        if (!UseTextureArrays())
+            return;
+        vector<unsigned int> ids;
+        for (const Texture &texture : textures_loaded)
+            ids.push_back(TextureCache::Instance().Shared(texture.id) ? 0 : texture.id);
+        unordered_map<unsigned int, TextureArraySlot> slots;
+        BuildTextureArrays(ids, slots, textureArrays);
+        if (slots.empty())
+            return;
+
+        // only the first texture of a type comes from an array, so a texture can still be bound as 2D elsewhere
+        unordered_set<unsigned int> bound;
+        for (Mesh &mesh : meshes)
+        {
+            mesh.ResolveTextureBindings(&slots);
+            for (const TextureBinding &binding : mesh.TextureBindings())
+                if (binding.target == GL_TEXTURE_2D)
+                    bound.insert(binding.id);
+        }
+        unsigned int released = 0;
+        for (Texture &texture : textures_loaded)
+        {
+            if (!slots.count(texture.id) || bound.count(texture.id))
+                continue;
+            for (Mesh &mesh : meshes)
+                for (Texture &meshTexture : mesh.textures)
+                    if (meshTexture.id == texture.id)
+                        meshTexture.id = 0;
+            TextureCache::Instance().Release(texture.id);
+            texture.id = 0;
+            released++;
+        }
+        cout << "Model " << directory << ": " << slots.size() << " textures in " << textureArrays.size() << " texture arrays, "
+             << released << " 2D textures released" << endl;
     }
+};
 
-    return textureID;
+
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+{
+    ImageData image;
+    image.path = directory + '/' + string(path);
+    DecodeImage(image);
+    return UploadImage(image);
 }
 #endif
@@ -0,0 +1,63 @@
+#ifndef MODEL_STREAMER_H
+#define MODEL_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/model.h>
+
+#include <vector>
+using namespace std;
+
+// Spreads the GPU uploads of asynchronously loaded models over several frames. Every frame at most bytesPerFrame
+// bytes of vertex/index/texture data are uploaded (textures go through a pixel buffer object), so the render loop
+// keeps running while the scene fills in.
+class ModelStreamer
+{
+public:
+    explicit ModelStreamer(size_t bytesPerFrame) : bytesPerFrame(bytesPerFrame)
+    {
+        glGenBuffers(1, &pbo);
+    }
+
+    ~ModelStreamer()
+    {
+        glDeleteBuffers(1, &pbo);
+    }
+
+    ModelStreamer(const ModelStreamer &) = delete;
+    ModelStreamer &operator=(const ModelStreamer &) = delete;
+
+    void Add(Model &model)
+    {
+        models.push_back(&model);
+    }
+
+    // uploads the next pieces of the models that are still streaming, in the order they were added.
+    // call once per frame from the GL thread.
+    void Update()
+    {
+        size_t budget = bytesPerFrame;
+        for (Model *model : models)
+        {
+            if (budget == 0)
+                break;
+            size_t uploaded = model->StreamUploads(budget, pbo);
+            budget = uploaded >= budget ? 0 : budget - uploaded;
+        }
+    }
+
+    // true once every model is completely resident
+    bool Done() const
+    {
+        for (const Model *model : models)
+            if (!model->IsLoaded())
+                return false;
+        return true;
+    }
+
+private:
+    size_t bytesPerFrame;
+    unsigned int pbo;
+    vector<Model *> models;
+};
+#endif
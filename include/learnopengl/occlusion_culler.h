@@ -0,0 +1,172 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/render_stats.h>
+#include <learnopengl/shader.h>
+
+#include <vector>
+using namespace std;
+
+// frames an object that was found visible stays visible before its box is queried again. hidden objects are queried
+// every frame, so they come back as soon as they can be seen.
+const unsigned int OCCLUSION_VISIBLE_INTERVAL = 4;
+// a camera this close to a box makes it visible without a query, the near plane could cut away its front faces.
+// larger than the distance from the camera to the corners of the near plane.
+const float OCCLUSION_NEAR_MARGIN = 0.2f;
+
+// Hardware occlusion culling with temporal coherence, after coherent hierarchical culling (CHC). Once the scene is
+// drawn, the boxes of the objects are rendered against its depth buffer inside GL_ANY_SAMPLES_PASSED queries, and the
+// following frames skip the objects whose box had no sample pass. A result is only read once the GPU reports it as
+// available, so the CPU never waits on a query; the price is that an object coming out from behind an occluder shows
+// up a frame late. Objects are referred to by small handles, the ones of SceneBVH.
+class OcclusionCuller
+{
+public:
+    // shader draws the boxes, see occlusion_box.vs
+    OcclusionCuller(Shader &shader) : shader(shader)
+    {
+        centerUniform = shader.uniform("boxCenter");
+        extentUniform = shader.uniform("boxExtent");
+
+        // unit cube [-1, 1], 8 corners and 12 triangles
+        float corners[] = {
+            -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f, 1.0f, -1.0f,   -1.0f, 1.0f, -1.0f,
+            -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f, 1.0f,  1.0f,   -1.0f, 1.0f,  1.0f
+        };
+        unsigned char indices[] = {
+            0, 2, 1, 0, 3, 2,   4, 5, 6, 4, 6, 7,   0, 1, 5, 0, 5, 4,
+            3, 6, 2, 3, 7, 6,   0, 4, 7, 0, 7, 3,   1, 2, 6, 1, 6, 5
+        };
+        glGenVertexArrays(1, &cubeVAO);
+        glGenBuffers(1, &cubeVBO);
+        glGenBuffers(1, &cubeEBO);
+        glBindVertexArray(cubeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+    }
+
+    ~OcclusionCuller()
+    {
+        for (const Object &object : objects)
+        {
+            if (object.query)
+                glDeleteQueries(1, &object.query);
+        }
+        glDeleteVertexArrays(1, &cubeVAO);
+        glDeleteBuffers(1, &cubeVBO);
+        glDeleteBuffers(1, &cubeEBO);
+    }
+
+    OcclusionCuller(const OcclusionCuller &) = delete;
+    OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+    // starts a frame: takes in the query results that arrived since the last one, the others stay in flight
+    void BeginFrame()
+    {
+        frame++;
+        for (Object &object : objects)
+        {
+            if (!object.pending)
+                continue;
+            GLuint available = 0;
+            glGetQueryObjectuiv(object.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint anySamples = 0;
+            glGetQueryObjectuiv(object.query, GL_QUERY_RESULT, &anySamples);
+            object.visible = anySamples != 0;
+            object.pending = false;
+        }
+    }
+
+    // false if the box of the object was hidden the last time it was queried. objects that weren't queried in the
+    // previous frame (outside of the frustum, or occlusion culling was off) count as visible, their result is stale.
+    bool Visible(unsigned int handle) const
+    {
+        if (handle >= objects.size())
+            return true;
+        const Object &object = objects[handle];
+        return object.visible || object.checkedFrame + 1 < frame;
+    }
+
+    // sets up the box queries: depth test against the scene's depth buffer, no color or depth writes, both faces
+    void BeginQueries(const glm::vec3 &cameraPosition)
+    {
+        this->cameraPosition = cameraPosition;
+        cullFace = glIsEnabled(GL_CULL_FACE);
+        shader.use();
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_CULL_FACE);
+        glBindVertexArray(cubeVAO);
+    }
+
+    // queries the world space box of an object for the next frames, between BeginQueries and EndQueries. call it for
+    // every object that could be seen this frame, drawn or not. objects with a query still in flight and visible ones
+    // that aren't due yet are skipped.
+    void Query(unsigned int handle, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        if (handle >= objects.size())
+            objects.resize(handle + 1);
+        Object &object = objects[handle];
+        bool checkedLastFrame = object.checkedFrame + 1 == frame;
+        object.checkedFrame = frame;
+        if (object.pending)
+            return;
+        if (glm::all(glm::lessThanEqual(boxMin - glm::vec3(OCCLUSION_NEAR_MARGIN), cameraPosition))
+            && glm::all(glm::lessThanEqual(cameraPosition, boxMax + glm::vec3(OCCLUSION_NEAR_MARGIN))))
+        {
+            object.visible = true;
+            return;
+        }
+        // visible objects are spread over the interval by their handle, so they don't all come due in one frame
+        if (checkedLastFrame && object.visible && (frame + handle) % OCCLUSION_VISIBLE_INTERVAL != 0)
+            return;
+
+        if (!object.query)
+            glGenQueries(1, &object.query);
+        shader.setVec3(centerUniform, (boxMin + boxMax) * 0.5f);
+        shader.setVec3(extentUniform, (boxMax - boxMin) * 0.5f);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, object.query);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, 0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        object.pending = true;
+        FrameStats().occlusionQueries++;
+    }
+
+    // restores the state BeginQueries changed
+    void EndQueries()
+    {
+        glBindVertexArray(0);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        if (cullFace)
+            glEnable(GL_CULL_FACE);
+    }
+
+private:
+    struct Object {
+        unsigned int query = 0;
+        bool pending = false;           // a query was issued and its result hasn't been read yet
+        bool visible = true;            // result of the last query read
+        unsigned int checkedFrame = 0;  // last frame Query was called for the object
+    };
+
+    Shader &shader;
+    UniformLocation centerUniform, extentUniform;
+    unsigned int cubeVAO = 0, cubeVBO = 0, cubeEBO = 0;
+    vector<Object> objects;
+    unsigned int frame = 1;
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    GLboolean cullFace = GL_TRUE;
+};
+#endif
@@ -0,0 +1,109 @@
+#ifndef PING_PONG_BLUR_H
+#define PING_PONG_BLUR_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include <iostream>
+
+// Separable Gaussian blur in the fragment shader (blur.fs). Every iteration is a horizontal and a vertical pass; Pass
+// draws one of them into the bound framebuffer, for callers that bring their own targets (the frame graph), Render
+// runs all of them alternating between two framebuffers of its own. The kernel is whatever SetBlurKernel last gave the
+// shader.
+class PingPongBlur
+{
+public:
+    PingPongBlur(Shader &shader) : shader(shader)
+    {
+        shader.use();
+        shader.setInt("image", 0);
+        horizontalUniform = shader.uniform("horizontal");
+    }
+
+    ~PingPongBlur()
+    {
+        deleteTargets();
+    }
+
+    PingPongBlur(const PingPongBlur &) = delete;
+    PingPongBlur &operator=(const PingPongBlur &) = delete;
+
+    // one pass over source into the bound framebuffer. drawQuad draws a screen filling quad.
+    void Pass(unsigned int source, bool horizontal, void (*drawQuad)())
+    {
+        shader.use();
+        shader.setInt(horizontalUniform, horizontal);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, source);
+        drawQuad();
+    }
+
+    // blurs source over the given number of iterations at width x height and returns the texture holding the result.
+    // leaves the default framebuffer bound, the viewport is restored.
+    unsigned int Render(unsigned int source, unsigned int width, unsigned int height, unsigned int iterations,
+                        void (*drawQuad)())
+    {
+        if (width != this->width || height != this->height)
+            createTargets(width, height);
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glViewport(0, 0, width, height);
+        bool horizontal = true, first_iteration = true;
+        for (unsigned int i = 0; i < 2 * iterations; i++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[horizontal]);
+            Pass(first_iteration ? source : textures[!horizontal], horizontal, drawQuad);  // texture of other framebuffer (or scene if first iteration)
+            horizontal = !horizontal;
+            if (first_iteration)
+                first_iteration = false;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        return textures[!horizontal];
+    }
+
+private:
+    Shader &shader;
+    UniformLocation horizontalUniform;
+    // Render's targets, created on its first call
+    unsigned int width = 0, height = 0;
+    unsigned int framebuffers[2] = {};
+    unsigned int textures[2] = {};
+
+    void createTargets(unsigned int width, unsigned int height)
+    {
+        deleteTargets();
+        this->width = width;
+        this->height = height;
+        glGenFramebuffers(2, framebuffers);
+        glGenTextures(2, textures);
+        for (unsigned int i = 0; i < 2; i++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+
+            // also check if framebuffers are complete (no need for depth buffer)
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "Framebuffer not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void deleteTargets()
+    {
+        if (!framebuffers[0])
+            return;
+        glDeleteFramebuffers(2, framebuffers);
+        glDeleteTextures(2, textures);
+        framebuffers[0] = framebuffers[1] = 0;
+        textures[0] = textures[1] = 0;
+    }
+};
+#endif
@@ -0,0 +1,313 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/indirect_draw.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/render_stats.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// which group of the frame a draw belongs to, drawn in this order. opaque draws go first so they fill the depth buffer
+// before the draws that discard fragments, the skybox only covers what is left, and blended draws come last.
+enum Render_Layer {
+    LAYER_OPAQUE,
+    LAYER_ALPHA_TESTED,
+    LAYER_SKY,
+    LAYER_BLENDED
+};
+
+// Sort key of a draw, most significant bits first:
+//   layer 2 | shader 8 | material 16 | VAO 14 | depth 24       opaque, alpha tested and sky draws
+//   layer 2 | inverted depth 24 | shader 8 | material 16 | VAO 14   blended draws
+// so within a layer the draws are grouped by program, then textures, then vertex array, and draws with the same state
+// go front to back. blended draws have to be back to front, which only leaves the state as a tie breaker.
+const unsigned int SORT_LAYER_BITS = 2;
+const unsigned int SORT_SHADER_BITS = 8;
+const unsigned int SORT_MATERIAL_BITS = 16;
+const unsigned int SORT_VAO_BITS = 14;
+const unsigned int SORT_DEPTH_BITS = 24;
+
+// texture units the queue tracks bindings for, the material units of mesh.h
+const unsigned int RENDER_QUEUE_TEXTURE_UNITS = MATERIAL_TEXTURE_UNITS;
+
+// Collects the draws of a frame with a sort key each, sorts them with a radix sort and submits them in that order,
+// skipping program, texture and vertex array binds that are already in place. Begin starts a frame, the Submit calls
+// queue draws in any order, and Execute draws and empties the queue. On GL 4.3+ the draws submitted as indirect that
+// end up next to each other with the same program, textures and vertex array are drawn with one
+// glMultiDrawElementsIndirect (see indirect_draw.h), on GL 3.3 there are none and every draw is its own call.
+class RenderQueue
+{
+public:
+    // starts collecting a frame. depths are distances from cameraPosition, quantized over [0, maxDepth].
+    void Begin(const glm::vec3 &cameraPosition, float maxDepth)
+    {
+        this->cameraPosition = cameraPosition;
+        this->maxDepth = maxDepth;
+        instance = 0;
+        items.clear();
+    }
+
+    // queues a range of a mesh with the model matrix in modelUniform. vao is the VAO holding the mesh (its model's),
+    // center the world space point the depth is measured to. meshes of one model instance should share an instance
+    // number from NextInstance, so the model matrix is only set once for them. instanceCount above one draws the mesh
+    // instanced, with a VAO that has an instance buffer. indirect draws need a VAO attached to IndirectBuffers, which
+    // gets the model matrix per draw; modelUniform is set to the identity for them.
+    void SubmitMesh(Render_Layer layer, Shader &shader, UniformLocation modelUniform, const glm::mat4 &model, unsigned int instance,
+                    unsigned int vao, Mesh &mesh, unsigned int lod, const glm::vec3 &center, unsigned int instanceCount = 1,
+                    bool indirect = false)
+    {
+        RenderItem item;
+        item.key = makeKey(layer, shader.ID, mesh.MaterialKey(), vao, center);
+        item.shader = &shader;
+        item.mesh = &mesh;
+        item.lod = lod;
+        item.vao = vao;
+        item.modelUniform = modelUniform;
+        item.model = model;
+        item.instance = instance;
+        item.instanceCount = instanceCount;
+        item.indirect = indirect && instanceCount == 1;
+        items.push_back(item);
+    }
+
+    // queues a draw the caller makes itself. draw runs with shader in use and may bind any textures and vertex array,
+    // any other state it changes it has to restore.
+    void SubmitCustom(Render_Layer layer, Shader &shader, const glm::vec3 &center, std::function<void()> draw)
+    {
+        RenderItem item;
+        item.key = makeKey(layer, shader.ID, 0, 0, center);
+        item.shader = &shader;
+        item.draw = std::move(draw);
+        items.push_back(item);
+    }
+
+    // a fresh instance number for SubmitMesh
+    unsigned int NextInstance()
+    {
+        return ++instance;
+    }
+
+    // sorts the queued draws and submits them, then empties the queue
+    void Execute()
+    {
+        sortItems();
+
+        // the commands and matrices of all indirect draws are written up front in draw order, so the draws of a
+        // batch are a contiguous range of them
+        IndirectDrawBuffers *indirect = nullptr;
+        size_t indirectCount = 0;
+        for (const RenderItem &item : items)
+            indirectCount += item.indirect;
+        if (indirectCount > 0)
+        {
+            indirect = &IndirectBuffers();
+            indirect->BeginFrame(indirectCount);
+            for (const SortEntry &entry : sorted)
+            {
+                RenderItem &item = items[entry.item];
+                if (item.indirect)
+                    item.command = indirect->Add(*item.mesh, item.lod, item.model);
+            }
+            indirect->Upload();
+        }
+
+        RenderStats &stats = FrameStats();
+        const unsigned int UNKNOWN_BINDING = ~0u;
+        unsigned int program = 0, vao = UNKNOWN_BINDING, instance = 0;
+        unsigned int textures[RENDER_QUEUE_TEXTURE_UNITS];
+        std::fill(textures, textures + RENDER_QUEUE_TEXTURE_UNITS, UNKNOWN_BINDING);
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            RenderItem &item = items[sorted[i].item];
+            if (item.shader->ID != program)
+            {
+                item.shader->use();
+                program = item.shader->ID;
+                instance = 0;
+                stats.programChanges++;
+            }
+            if (!item.mesh)
+            {
+                item.draw();
+                // whatever the draw bound or set is unknown now
+                vao = UNKNOWN_BINDING;
+                instance = 0;
+                std::fill(textures, textures + RENDER_QUEUE_TEXTURE_UNITS, UNKNOWN_BINDING);
+                continue;
+            }
+
+            if (item.vao != vao)
+            {
+                glBindVertexArray(item.vao);
+                vao = item.vao;
+                stats.vertexArrayChanges++;
+            }
+            for (const TextureBinding &binding : item.mesh->TextureBindings())
+            {
+                if (binding.unit >= RENDER_QUEUE_TEXTURE_UNITS || textures[binding.unit] != binding.id)
+                {
+                    glActiveTexture(GL_TEXTURE0 + binding.unit);
+                    glBindTexture(binding.target, binding.id);
+                    if (binding.unit < RENDER_QUEUE_TEXTURE_UNITS)
+                        textures[binding.unit] = binding.id;
+                    stats.textureBinds++;
+                }
+            }
+            if (item.indirect)
+            {
+                size_t last = i;
+                while (last + 1 < sorted.size() && sameBatch(item, items[sorted[last + 1].item]))
+                    last++;
+                // the draw matrices carry the model matrix and the dequantization of each mesh
+                const DequantizationUniforms &uniforms = dequantizationUniforms(*item.shader);
+                item.shader->setMat4(item.modelUniform, glm::mat4(1.0f));
+                item.shader->setVec3(uniforms.scale, glm::vec3(1.0f));
+                item.shader->setVec3(uniforms.offset, glm::vec3(0.0f));
+                instance = 0;
+                indirect->Draw(item.command, (unsigned int) (last - i + 1), item.mesh->indexType);
+                stats.drawCalls++;
+                for (size_t j = i; j <= last; j++)
+                {
+                    const Mesh &mesh = *items[sorted[j].item].mesh;
+                    stats.triangles += (size_t) mesh.lods[std::min<size_t>(items[sorted[j].item].lod, mesh.lods.size() - 1)].indexCount / 3;
+                    stats.fullDetailTriangles += (size_t) mesh.lods[0].indexCount / 3;
+                    stats.multiDrawCommands++;
+                }
+                i = last;
+                continue;
+            }
+            if (item.instance != instance)
+            {
+                item.shader->setMat4(item.modelUniform, item.model);
+                instance = item.instance;
+            }
+            item.mesh->DrawElements(*item.shader, item.lod, item.instanceCount);
+        }
+        if (indirect)
+            indirect->EndFrame();
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        items.clear();
+    }
+
+private:
+    struct RenderItem {
+        uint64_t key = 0;
+        Shader *shader = nullptr;
+        // mesh draws
+        Mesh *mesh = nullptr;
+        unsigned int lod = 0;
+        unsigned int vao = 0;
+        UniformLocation modelUniform;
+        glm::mat4 model;
+        unsigned int instance = 0;
+        unsigned int instanceCount = 1;
+        bool indirect = false;
+        unsigned int command = 0;   // index in IndirectBuffers this frame
+        // custom draws
+        std::function<void()> draw;
+    };
+
+    struct DequantizationUniforms {
+        UniformLocation scale, offset;
+    };
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float maxDepth = 1.0f;
+    unsigned int instance = 0;
+    vector<RenderItem> items;
+    vector<SortEntry> sorted, scratch;
+    // small numbers for the programs, materials and VAOs seen so far, in the order they were first submitted
+    unordered_map<uint64_t, uint64_t> shaderSlots, materialSlots, vaoSlots;
+    unordered_map<unsigned int, DequantizationUniforms> dequantization;
+
+    // the packed position uniforms of a program, see Mesh::DrawElements
+    const DequantizationUniforms &dequantizationUniforms(const Shader &shader)
+    {
+        auto it = dequantization.find(shader.ID);
+        if (it == dequantization.end())
+            it = dequantization.emplace(shader.ID, DequantizationUniforms{shader.uniform("positionScale"), shader.uniform("positionOffset")}).first;
+        return it->second;
+    }
+
+    // whether next can join the multi-draw of first: both indirect and with the same program, textures, vertex
+    // array and index type
+    static bool sameBatch(const RenderItem &first, const RenderItem &next)
+    {
+        return next.indirect && next.shader->ID == first.shader->ID && next.vao == first.vao
+               && next.mesh->MaterialKey() == first.mesh->MaterialKey() && next.mesh->indexType == first.mesh->indexType;
+    }
+
+    // the dense number of value, so GL names and material hashes fit into their few key bits. numbers past the field
+    // width wrap around, which only makes draws with different state sort as if they shared it.
+    static uint64_t slot(unordered_map<uint64_t, uint64_t> &slots, uint64_t value, unsigned int bits)
+    {
+        auto it = slots.find(value);
+        if (it == slots.end())
+            it = slots.emplace(value, slots.size()).first;
+        return it->second & ((uint64_t(1) << bits) - 1);
+    }
+
+    uint64_t makeKey(Render_Layer layer, unsigned int shader, uint64_t material, unsigned int vao, const glm::vec3 &center)
+    {
+        const uint64_t depthMax = (uint64_t(1) << SORT_DEPTH_BITS) - 1;
+        float distance = glm::length(center - cameraPosition) / maxDepth;
+        uint64_t depth = (uint64_t) (std::min(1.0f, std::max(0.0f, distance)) * depthMax);
+        uint64_t state = slot(shaderSlots, shader, SORT_SHADER_BITS);
+        state = state << SORT_MATERIAL_BITS | slot(materialSlots, material, SORT_MATERIAL_BITS);
+        state = state << SORT_VAO_BITS | slot(vaoSlots, vao, SORT_VAO_BITS);
+
+        const unsigned int stateBits = SORT_SHADER_BITS + SORT_MATERIAL_BITS + SORT_VAO_BITS;
+        uint64_t key = layer;
+        if (layer == LAYER_BLENDED)
+            key = (key << SORT_DEPTH_BITS | (depthMax - depth)) << stateBits | state;
+        else
+            key = (key << stateBits | state) << SORT_DEPTH_BITS | depth;
+        return key;
+    }
+
+    // least significant digit radix sort of the keys, 8 bits per pass. passes over a byte all keys share are skipped,
+    // which with the dense slots is most of the upper ones. stable, so equal keys keep their submit order.
+    void sortItems()
+    {
+        sorted.resize(items.size());
+        scratch.resize(items.size());
+        for (uint32_t i = 0; i < items.size(); i++)
+            sorted[i] = SortEntry{items[i].key, i};
+
+        for (unsigned int shift = 0; shift < 64; shift += 8)
+        {
+            size_t counts[256] = {0};
+            for (const SortEntry &entry : sorted)
+                counts[(entry.key >> shift) & 0xff]++;
+            if (sorted.empty() || counts[(sorted[0].key >> shift) & 0xff] == sorted.size())
+                continue;
+            size_t offset = 0;
+            for (size_t &count : counts)
+            {
+                size_t start = offset;
+                offset += count;
+                count = start;
+            }
+            for (const SortEntry &entry : sorted)
+                scratch[counts[(entry.key >> shift) & 0xff]++] = entry;
+            sorted.swap(scratch);
+        }
+    }
+};
+#endif
@@ -0,0 +1,39 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstddef>
+
+// what the draw calls of the current frame submitted. Mesh::Draw, Model, the RenderQueue and the FrameGraph add to it,
+// the render loop reads it once per frame and resets it with ResetFrameStats.
+struct RenderStats {
+    unsigned int drawCalls = 0;
+    size_t triangles = 0;               // triangles actually drawn, with the selected LODs
+    size_t fullDetailTriangles = 0;     // triangles the same draws would have had at LOD 0
+    // meshes frustum culling kept and dropped, instanced copies count once per copy
+    unsigned int meshesVisible = 0;
+    unsigned int meshesCulled = 0;
+    // state changes of the render queue
+    unsigned int programChanges = 0;
+    unsigned int vertexArrayChanges = 0;
+    unsigned int textureBinds = 0;
+    // mesh draws that went through glMultiDrawElementsIndirect, each of those calls counts once in drawCalls
+    unsigned int multiDrawCommands = 0;
+    // occlusion culling: box queries issued and objects skipped because their box was hidden
+    unsigned int occlusionQueries = 0;
+    unsigned int objectsOccluded = 0;
+    // frame graph passes that ran and that were culled because nothing used their results
+    unsigned int passes = 0;
+    unsigned int passesCulled = 0;
+};
+
+RenderStats &FrameStats()
+{
+    static RenderStats stats;
+    return stats;
+}
+
+void ResetFrameStats()
+{
+    FrameStats() = RenderStats();
+}
+#endif
@@ -0,0 +1,394 @@
+#ifndef SCENE_BVH_H
+#define SCENE_BVH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// objects per leaf the build aims for, and the bins the surface area heuristic evaluates per axis
+const unsigned int BVH_LEAF_OBJECTS = 4;
+const unsigned int BVH_SAH_BINS = 16;
+
+// world space box of an object space box under a model matrix (Arvo's method), encloses the transformed corners
+void TransformBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax, const glm::mat4 &model, glm::vec3 &outMin, glm::vec3 &outMax)
+{
+    outMin = outMax = glm::vec3(model[3]);
+    for (int column = 0; column < 3; column++)
+    {
+        for (int row = 0; row < 3; row++)
+        {
+            float a = model[column][row] * boxMin[column], b = model[column][row] * boxMax[column];
+            outMin[row] += std::min(a, b);
+            outMax[row] += std::max(a, b);
+        }
+    }
+}
+
+struct BvhNode {
+    glm::vec3 boxMin, boxMax;
+    uint32_t child;         // index of the first of the two children, 0 for leaves
+    uint32_t first, count;  // the objects of the whole subtree, a range of the tree's object order
+};
+
+struct BvhRayHit {
+    unsigned int handle;
+    float distance;     // along the ray to where it enters the object's box
+};
+
+// Bounding volume hierarchy over the world space boxes of the scene objects. Static objects go into a tree built once
+// with the surface area heuristic; dynamic ones into a second tree that is built the same way and afterwards only has
+// its boxes refit to the objects' new boxes every frame (its shape gets worse as they move, Build fixes that).
+// Objects are referred to by the handles Add returns, which count up from 0.
+class SceneBVH
+{
+public:
+    // adds an object, it takes part in the queries from the next Build on
+    unsigned int Add(const glm::vec3 &boxMin, const glm::vec3 &boxMax, bool dynamic = false)
+    {
+        objects.push_back(Object{boxMin, boxMax, dynamic});
+        return objects.size() - 1;
+    }
+
+    // moves a dynamic object, Refit brings the tree up to date
+    void Update(unsigned int handle, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        objects[handle].boxMin = boxMin;
+        objects[handle].boxMax = boxMax;
+    }
+
+    // builds both trees from the objects added so far
+    void Build()
+    {
+        staticTree.order.clear();
+        dynamicTree.order.clear();
+        for (uint32_t i = 0; i < objects.size(); i++)
+            (objects[i].dynamic ? dynamicTree : staticTree).order.push_back(i);
+        buildTree(staticTree);
+        buildTree(dynamicTree);
+        built = true;
+    }
+
+    // recomputes the boxes of the dynamic tree from its objects, children come after their parents in the node array
+    void Refit()
+    {
+        vector<BvhNode> &nodes = dynamicTree.nodes;
+        for (size_t i = nodes.size(); i-- > 0;)
+        {
+            BvhNode &node = nodes[i];
+            if (node.child != 0)
+            {
+                node.boxMin = glm::min(nodes[node.child].boxMin, nodes[node.child + 1].boxMin);
+                node.boxMax = glm::max(nodes[node.child].boxMax, nodes[node.child + 1].boxMax);
+            }
+            else
+                rangeBounds(dynamicTree, node.first, node.count, node.boxMin, node.boxMax);
+        }
+    }
+
+    bool Built() const
+    {
+        return built;
+    }
+
+    size_t Size() const
+    {
+        return objects.size();
+    }
+
+    size_t NodeCount() const
+    {
+        return staticTree.nodes.size() + dynamicTree.nodes.size();
+    }
+
+    // the current box of an object
+    void ObjectBox(unsigned int handle, glm::vec3 &boxMin, glm::vec3 &boxMax) const
+    {
+        boxMin = objects[handle].boxMin;
+        boxMax = objects[handle].boxMax;
+    }
+
+    // sets visible[handle] to 1 for the objects whose box is at least partly inside the frustum and to 0 for the
+    // others, returns the number of visible objects. subtrees completely inside a plane don't test it again, subtrees
+    // completely inside the frustum are taken without any further tests.
+    size_t CullFrustum(const Frustum &frustum, vector<unsigned char> &visible) const
+    {
+        visible.assign(objects.size(), 0);
+        size_t count = 0;
+        for (const Tree *tree : {&staticTree, &dynamicTree})
+            if (!tree->nodes.empty())
+                count += cullNode(*tree, 0, frustum, 0x3f, visible);
+        return count;
+    }
+
+    // appends the objects whose box overlaps the given one to hits
+    void QueryBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax, vector<unsigned int> &hits) const
+    {
+        query([&](const glm::vec3 &nodeMin, const glm::vec3 &nodeMax) {
+            return glm::all(glm::lessThanEqual(nodeMin, boxMax)) && glm::all(glm::lessThanEqual(boxMin, nodeMax));
+        }, [&](unsigned int handle) { hits.push_back(handle); });
+    }
+
+    // appends the objects whose box overlaps the sphere to hits
+    void QuerySphere(const glm::vec3 &center, float radius, vector<unsigned int> &hits) const
+    {
+        query([&](const glm::vec3 &nodeMin, const glm::vec3 &nodeMax) {
+            glm::vec3 offset = center - glm::clamp(center, nodeMin, nodeMax);
+            return glm::dot(offset, offset) <= radius * radius;
+        }, [&](unsigned int handle) { hits.push_back(handle); });
+    }
+
+    // the objects whose box the ray from origin along direction enters within maxDistance (in units of direction's
+    // length), closest first
+    void QueryRay(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, vector<BvhRayHit> &hits) const
+    {
+        glm::vec3 inverse = 1.0f / direction;
+        size_t first = hits.size();
+        query([&](const glm::vec3 &nodeMin, const glm::vec3 &nodeMax) {
+            float distance;
+            return rayBox(origin, inverse, nodeMin, nodeMax, maxDistance, distance);
+        }, [&](unsigned int handle) {
+            float distance;
+            rayBox(origin, inverse, objects[handle].boxMin, objects[handle].boxMax, maxDistance, distance);
+            hits.push_back(BvhRayHit{handle, distance});
+        });
+        std::sort(hits.begin() + first, hits.end(), [](const BvhRayHit &a, const BvhRayHit &b) { return a.distance < b.distance; });
+    }
+
+private:
+    struct Object {
+        glm::vec3 boxMin, boxMax;
+        bool dynamic;
+    };
+
+    struct Tree {
+        vector<BvhNode> nodes;
+        vector<uint32_t> order;     // object handles, every node covers a contiguous range
+    };
+
+    vector<Object> objects;
+    Tree staticTree, dynamicTree;
+    bool built = false;
+
+    void rangeBounds(const Tree &tree, uint32_t first, uint32_t count, glm::vec3 &boxMin, glm::vec3 &boxMax) const
+    {
+        boxMin = glm::vec3(INFINITY);
+        boxMax = glm::vec3(-INFINITY);
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            boxMin = glm::min(boxMin, objects[tree.order[i]].boxMin);
+            boxMax = glm::max(boxMax, objects[tree.order[i]].boxMax);
+        }
+    }
+
+    static float halfArea(const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        glm::vec3 size = glm::max(boxMax - boxMin, glm::vec3(0.0f));
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    glm::vec3 centroid(uint32_t handle) const
+    {
+        return (objects[handle].boxMin + objects[handle].boxMax) * 0.5f;
+    }
+
+    // top down build with binned SAH. a node is split where the summed area weighted object counts of the two halves
+    // are lowest, or becomes a leaf if that is no cheaper than testing its objects directly.
+    void buildTree(Tree &tree)
+    {
+        tree.nodes.clear();
+        if (tree.order.empty())
+            return;
+        tree.nodes.push_back(BvhNode{glm::vec3(0.0f), glm::vec3(0.0f), 0, 0, (uint32_t) tree.order.size()});
+        vector<uint32_t> pending(1, 0);
+        while (!pending.empty())
+        {
+            uint32_t index = pending.back();
+            pending.pop_back();
+            BvhNode node = tree.nodes[index];
+            rangeBounds(tree, node.first, node.count, node.boxMin, node.boxMax);
+            tree.nodes[index] = node;
+            if (node.count <= BVH_LEAF_OBJECTS)
+                continue;
+
+            glm::vec3 centroidMin(INFINITY), centroidMax(-INFINITY);
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                centroidMin = glm::min(centroidMin, centroid(tree.order[i]));
+                centroidMax = glm::max(centroidMax, centroid(tree.order[i]));
+            }
+
+            float bestCost = INFINITY;
+            int bestAxis = -1;
+            unsigned int bestSplit = 0;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float extent = centroidMax[axis] - centroidMin[axis];
+                if (extent <= 0.0f)
+                    continue;
+                unsigned int binCounts[BVH_SAH_BINS] = {0};
+                glm::vec3 binMin[BVH_SAH_BINS], binMax[BVH_SAH_BINS];
+                std::fill(binMin, binMin + BVH_SAH_BINS, glm::vec3(INFINITY));
+                std::fill(binMax, binMax + BVH_SAH_BINS, glm::vec3(-INFINITY));
+                for (uint32_t i = node.first; i < node.first + node.count; i++)
+                {
+                    const Object &object = objects[tree.order[i]];
+                    unsigned int bin = binOf(centroid(tree.order[i])[axis], centroidMin[axis], extent);
+                    binCounts[bin]++;
+                    binMin[bin] = glm::min(binMin[bin], object.boxMin);
+                    binMax[bin] = glm::max(binMax[bin], object.boxMax);
+                }
+                // sweep from the right for the areas and counts of every right half, then from the left
+                float rightCost[BVH_SAH_BINS];
+                glm::vec3 sweepMin(INFINITY), sweepMax(-INFINITY);
+                unsigned int sweepCount = 0;
+                for (unsigned int bin = BVH_SAH_BINS - 1; bin > 0; bin--)
+                {
+                    sweepMin = glm::min(sweepMin, binMin[bin]);
+                    sweepMax = glm::max(sweepMax, binMax[bin]);
+                    sweepCount += binCounts[bin];
+                    rightCost[bin] = sweepCount ? halfArea(sweepMin, sweepMax) * sweepCount : 0.0f;
+                }
+                sweepMin = glm::vec3(INFINITY);
+                sweepMax = glm::vec3(-INFINITY);
+                sweepCount = 0;
+                for (unsigned int split = 1; split < BVH_SAH_BINS; split++)
+                {
+                    sweepMin = glm::min(sweepMin, binMin[split - 1]);
+                    sweepMax = glm::max(sweepMax, binMax[split - 1]);
+                    sweepCount += binCounts[split - 1];
+                    if (sweepCount == 0 || sweepCount == node.count)
+                        continue;
+                    float cost = halfArea(sweepMin, sweepMax) * sweepCount + rightCost[split];
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = split;
+                    }
+                }
+            }
+
+            // one traversal step against testing every object of the node
+            float leafCost = halfArea(node.boxMin, node.boxMax) * node.count;
+            uint32_t *begin = tree.order.data() + node.first, *end = begin + node.count, *middle;
+            if (bestAxis >= 0 && (bestCost + halfArea(node.boxMin, node.boxMax) < leafCost || node.count > 4 * BVH_LEAF_OBJECTS))
+            {
+                float extent = centroidMax[bestAxis] - centroidMin[bestAxis];
+                middle = std::partition(begin, end, [&](uint32_t handle) {
+                    return binOf(centroid(handle)[bestAxis], centroidMin[bestAxis], extent) < bestSplit;
+                });
+            }
+            else if (node.count > 4 * BVH_LEAF_OBJECTS)
+                middle = begin + node.count / 2;    // all centroids in one spot, split by count so leaves stay small
+            else
+                continue;
+
+            uint32_t leftCount = middle - begin;
+            uint32_t child = tree.nodes.size();
+            tree.nodes[index].child = child;
+            tree.nodes.push_back(BvhNode{glm::vec3(0.0f), glm::vec3(0.0f), 0, node.first, leftCount});
+            tree.nodes.push_back(BvhNode{glm::vec3(0.0f), glm::vec3(0.0f), 0, node.first + leftCount, node.count - leftCount});
+            pending.push_back(child);
+            pending.push_back(child + 1);
+        }
+    }
+
+    static unsigned int binOf(float value, float start, float extent)
+    {
+        int bin = (int) ((value - start) / extent * BVH_SAH_BINS);
+        return (unsigned int) std::min(std::max(bin, 0), (int) BVH_SAH_BINS - 1);
+    }
+
+    // -1 if the box is completely behind the plane, 1 if completely in front of it, 0 if the plane cuts it
+    static int classifyBox(const glm::vec4 &plane, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        glm::vec3 normal(plane), center = (boxMin + boxMax) * 0.5f, extent = (boxMax - boxMin) * 0.5f;
+        float distance = glm::dot(normal, center) + plane.w;
+        float radius = glm::dot(glm::abs(normal), extent);
+        if (distance + radius < 0.0f)
+            return -1;
+        return distance - radius >= 0.0f ? 1 : 0;
+    }
+
+    // planes holds a bit for every frustum plane the node's parent isn't completely in front of
+    size_t cullNode(const Tree &tree, uint32_t index, const Frustum &frustum, unsigned int planes, vector<unsigned char> &visible) const
+    {
+        const BvhNode &node = tree.nodes[index];
+        for (unsigned int plane = 0; plane < 6; plane++)
+        {
+            if (!(planes & 1u << plane))
+                continue;
+            int side = classifyBox(frustum.planes[plane], node.boxMin, node.boxMax);
+            if (side < 0)
+                return 0;
+            if (side > 0)
+                planes &= ~(1u << plane);
+        }
+
+        if (node.child != 0 && planes != 0)
+            return cullNode(tree, node.child, frustum, planes, visible) + cullNode(tree, node.child + 1, frustum, planes, visible);
+
+        size_t count = 0;
+        for (uint32_t i = node.first; i < node.first + node.count; i++)
+        {
+            uint32_t handle = tree.order[i];
+            bool inside = true;
+            for (unsigned int plane = 0; plane < 6 && inside; plane++)
+                inside = !(planes & 1u << plane) || classifyBox(frustum.planes[plane], objects[handle].boxMin, objects[handle].boxMax) >= 0;
+            visible[handle] = inside;
+            count += inside;
+        }
+        return count;
+    }
+
+    // visits the objects of both trees whose box passes test, skipping the subtrees whose box doesn't
+    template <typename BoxTest, typename Visit>
+    void query(BoxTest test, Visit visit) const
+    {
+        vector<uint32_t> pending;
+        for (const Tree *tree : {&staticTree, &dynamicTree})
+        {
+            if (tree->nodes.empty())
+                continue;
+            pending.assign(1, 0);
+            while (!pending.empty())
+            {
+                const BvhNode &node = tree->nodes[pending.back()];
+                pending.pop_back();
+                if (!test(node.boxMin, node.boxMax))
+                    continue;
+                if (node.child != 0)
+                {
+                    pending.push_back(node.child);
+                    pending.push_back(node.child + 1);
+                    continue;
+                }
+                for (uint32_t i = node.first; i < node.first + node.count; i++)
+                {
+                    const Object &object = objects[tree->order[i]];
+                    if (test(object.boxMin, object.boxMax))
+                        visit(tree->order[i]);
+                }
+            }
+        }
+    }
+
+    // slab test, distance receives where the ray enters the box (0 if it starts inside)
+    static bool rayBox(const glm::vec3 &origin, const glm::vec3 &inverseDirection, const glm::vec3 &boxMin, const glm::vec3 &boxMax,
+                       float maxDistance, float &distance)
+    {
+        glm::vec3 t0 = (boxMin - origin) * inverseDirection, t1 = (boxMax - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+        float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        distance = enter;
+        return enter <= exit;
+    }
+};
+#endif
@@ -0,0 +1,154 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Material texture arrays: the 2D textures of a model that share a format, size and mip chain are copied into the
+// layers of one GL_TEXTURE_2D_ARRAY, so meshes with different textures end up with the same bindings and only differ
+// in the layers they sample (Mesh::materialLayers). That lets the render queue draw them together.
+
+// whether models move their textures into arrays once they are loaded, set before creating the models
+bool &UseTextureArrays()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+// where a texture went: the array and its layer in it
+struct TextureArraySlot {
+    unsigned int array;
+    unsigned int layer;
+};
+
+// what textures need in common to share an array
+struct TextureArrayFormat {
+    GLint internalFormat = 0;
+    GLint width = 0, height = 0;
+    GLint levels = 0;
+    GLint compressed = 0;
+
+    bool operator==(const TextureArrayFormat &other) const
+    {
+        return internalFormat == other.internalFormat && width == other.width && height == other.height
+               && levels == other.levels && compressed == other.compressed;
+    }
+};
+
+TextureArrayFormat QueryTextureArrayFormat(unsigned int texture)
+{
+    TextureArrayFormat format;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format.internalFormat);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &format.width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &format.height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &format.compressed);
+    // the levels that were uploaded, compressed textures may stop before 1x1
+    GLint maxLevel = 1000, width = format.width;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    while (width > 0 && format.levels <= maxLevel)
+    {
+        format.levels++;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, format.levels, GL_TEXTURE_WIDTH, &width);
+    }
+    return format;
+}
+
+// copies textures into arrays, one per format that at least two of them share (a texture alone in its format would
+// only be copied for nothing). slots receives the array and layer of every copied texture, arrays the new array
+// textures, which belong to the caller. the copies go through client memory, GL 3.3 has no GPU side copy between
+// textures; that is a one time cost when a model finishes loading.
+void BuildTextureArrays(const vector<unsigned int> &textures, unordered_map<unsigned int, TextureArraySlot> &slots,
+                        vector<unsigned int> &arrays)
+{
+    vector<TextureArrayFormat> formats;
+    vector<vector<unsigned int>> groups;
+    for (unsigned int texture : textures)
+    {
+        if (texture == 0 || slots.count(texture))
+            continue;
+        TextureArrayFormat format = QueryTextureArrayFormat(texture);
+        if (format.width == 0)
+            continue;
+        size_t group = std::find(formats.begin(), formats.end(), format) - formats.begin();
+        if (group == formats.size())
+        {
+            formats.push_back(format);
+            groups.push_back(vector<unsigned int>());
+        }
+        if (std::find(groups[group].begin(), groups[group].end(), texture) == groups[group].end())
+            groups[group].push_back(texture);
+    }
+
+    vector<unsigned char> pixels;
+    for (size_t group = 0; group < groups.size(); group++)
+    {
+        const TextureArrayFormat &format = formats[group];
+        const vector<unsigned int> &layers = groups[group];
+        if (layers.size() < 2)
+            continue;
+
+        // sampling parameters of the first texture, they all come from the same loader
+        glBindTexture(GL_TEXTURE_2D, layers[0]);
+        const GLenum parameters[] = {GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER,
+                                     GL_TEXTURE_SWIZZLE_R, GL_TEXTURE_SWIZZLE_G, GL_TEXTURE_SWIZZLE_B, GL_TEXTURE_SWIZZLE_A};
+        GLint values[sizeof(parameters) / sizeof(parameters[0])];
+        for (size_t i = 0; i < sizeof(parameters) / sizeof(parameters[0]); i++)
+            glGetTexParameteriv(GL_TEXTURE_2D, parameters[i], &values[i]);
+
+        unsigned int array;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        for (size_t i = 0; i < sizeof(parameters) / sizeof(parameters[0]); i++)
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, parameters[i], values[i]);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, format.levels - 1);
+
+        GLsizei layerCount = (GLsizei) layers.size();
+        for (GLint level = 0; level < format.levels; level++)
+        {
+            GLint width, height, imageSize = 0;
+            glBindTexture(GL_TEXTURE_2D, layers[0]);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+            if (format.compressed)
+            {
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &imageSize);
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format.internalFormat, width, height, layerCount, 0,
+                                       imageSize * layerCount, nullptr);
+            }
+            else
+            {
+                imageSize = width * height * 4;
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format.internalFormat, width, height, layerCount, 0, GL_RGBA,
+                             GL_UNSIGNED_BYTE, nullptr);
+            }
+
+            pixels.resize(imageSize);
+            for (GLsizei layer = 0; layer < layerCount; layer++)
+            {
+                glBindTexture(GL_TEXTURE_2D, layers[layer]);
+                if (format.compressed)
+                {
+                    glGetCompressedTexImage(GL_TEXTURE_2D, level, pixels.data());
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, format.internalFormat,
+                                              imageSize, pixels.data());
+                }
+                else
+                {
+                    glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+                }
+            }
+        }
+        for (GLsizei layer = 0; layer < layerCount; layer++)
+            slots[layers[layer]] = TextureArraySlot{array, (unsigned int) layer};
+        arrays.push_back(array);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+#endif
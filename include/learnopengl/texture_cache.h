@@ -0,0 +1,240 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/texture_loader.h>
+
+#include <stdlib.h>
+
+#include <climits>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+using namespace std;
+
+// identifies a texture in the cache. two requests share a texture only if they refer to the same file and want it
+// in the same colorspace with the same sampler setup and usage (which decides the compressed format).
+struct TextureKey {
+    string path;    // canonical absolute path, see CanonicalTexturePath
+    Texture_Colorspace colorspace;
+    Texture_Wrap wrap;
+    Texture_Usage usage;
+
+    bool operator==(const TextureKey &other) const
+    {
+        return path == other.path && colorspace == other.colorspace && wrap == other.wrap && usage == other.usage;
+    }
+};
+
+struct TextureKeyHash {
+    size_t operator()(const TextureKey &key) const
+    {
+        return std::hash<string>()(key.path) ^ ((size_t) key.colorspace << 1) ^ ((size_t) key.wrap << 2) ^ ((size_t) key.usage << 3);
+    }
+};
+
+// resolves "a/../b" style paths and symlinks, so different spellings of the same file map to one cache entry
+string CanonicalTexturePath(const string &path)
+{
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved))
+        return string(resolved);
+    return path;    // missing files keep their path, they fail to load anyway
+}
+
+TextureKey MakeTextureKey(const string &path, Texture_Colorspace colorspace = COLORSPACE_LINEAR, Texture_Wrap wrap = WRAP_REPEAT,
+                          Texture_Usage usage = USAGE_COLOR)
+{
+    TextureKey key;
+    key.path = CanonicalTexturePath(path);
+    key.colorspace = colorspace;
+    key.wrap = wrap;
+    key.usage = usage;
+    return key;
+}
+
+// Process-wide cache of 2D textures, shared by all models and the scene code. Every user holds a reference on the
+// textures it got from the cache and gives it back with Release; the GL texture is deleted with the last reference.
+// A loader that is going to decode a texture claims its key first, so loaders that ask for it in the meantime wait
+// for that upload instead of decoding the image again. Acquire, Claim and Pending may be called from loader threads,
+// everything that makes GL calls only from the GL thread.
+class TextureCache
+{
+public:
+    static TextureCache &Instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // returns the cached texture for the key and takes a reference on it, or 0 if it isn't loaded yet
+    unsigned int Acquire(const TextureKey &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end())
+            return 0;
+        it->second.refCount++;
+        return it->second.id;
+    }
+
+    // like Acquire, but when the texture isn't loaded claimed tells whether the caller is now the one to decode it
+    // (and has to Insert or Abandon the key), or another loader is on it already: its texture can be taken with
+    // Acquire once the key isn't Pending anymore.
+    unsigned int Claim(const TextureKey &key, bool &claimed)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            claimed = false;
+            it->second.refCount++;
+            return it->second.id;
+        }
+        claimed = pending.insert(key).second;
+        return 0;
+    }
+
+    // whether a loader claimed the key and hasn't inserted its texture yet
+    bool Pending(const TextureKey &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending.count(key) != 0;
+    }
+
+    // gives up a claim without a texture, e.g. for a model destroyed while streaming
+    void Abandon(const TextureKey &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.erase(key);
+    }
+
+    // registers a freshly uploaded texture with one reference and ends a claim on its key. if another user uploaded
+    // the same texture in the meantime, the new copy is deleted and the existing texture is returned instead.
+    unsigned int Insert(const TextureKey &key, unsigned int id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.erase(key);
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            glDeleteTextures(1, &id);
+            it->second.refCount++;
+            return it->second.id;
+        }
+        Entry entry;
+        entry.id = id;
+        entry.refCount = 1;
+        entries.emplace(key, entry);
+        keysById.emplace(id, key);
+        return id;
+    }
+
+    // convenience for the GL thread: returns the cached texture or decodes and uploads it, holding a reference either way
+    unsigned int Load(const string &path, Texture_Colorspace colorspace = COLORSPACE_LINEAR, Texture_Wrap wrap = WRAP_REPEAT,
+                      Texture_Usage usage = USAGE_COLOR)
+    {
+        return Load(MakeTextureKey(path, colorspace, wrap, usage));
+    }
+
+    // the same for a key. a texture another loader claimed is decoded here as well, the GL thread can't wait for an
+    // upload that runs on it.
+    unsigned int Load(const TextureKey &key)
+    {
+        unsigned int id = Acquire(key);
+        if (id != 0)
+            return id;
+
+        ImageData image = MakeImage(key);
+        DecodeImage(image);
+        return Insert(key, UploadImage(image));
+    }
+
+    // block compress the textures loaded from now on, see texture_compressor.h. call on the GL thread before any
+    // loader threads start, it queries which compressed formats the driver supports.
+    void EnableCompression(bool enable)
+    {
+        compress = enable;
+        s3tc = enable && S3TCSupported();
+        if (enable && !s3tc)
+            std::cout << "WARNING::TEXTURE_CACHE:: no S3TC support, color textures stay uncompressed" << std::endl;
+    }
+
+    // the image to decode for a key, with the compression settings applied
+    ImageData MakeImage(const TextureKey &key) const
+    {
+        ImageData image;
+        image.path = key.path;
+        image.colorspace = key.colorspace;
+        image.wrap = key.wrap;
+        image.usage = key.usage;
+        image.compress = compress;
+        image.s3tc = s3tc;
+        return image;
+    }
+
+    // drops a reference; the texture is deleted once nobody uses it anymore
+    void Release(unsigned int id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (shutDown)
+            return;
+        auto byId = keysById.find(id);
+        if (byId == keysById.end())
+            return;
+        auto it = entries.find(byId->second);
+        if (--it->second.refCount == 0)
+        {
+            glDeleteTextures(1, &id);
+            entries.erase(it);
+            keysById.erase(byId);
+        }
+    }
+
+    // deletes all remaining textures, call before the GL context goes away. later releases are ignored.
+    void Shutdown()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &entry : entries)
+            glDeleteTextures(1, &entry.second.id);
+        entries.clear();
+        keysById.clear();
+        pending.clear();
+        shutDown = true;
+    }
+
+    // whether more than one reference is held on the texture, e.g. by several models
+    bool Shared(unsigned int id)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto byId = keysById.find(id);
+        return byId != keysById.end() && entries.at(byId->second).refCount > 1;
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        unsigned int id;
+        unsigned int refCount;
+    };
+
+    std::mutex mutex;
+    unordered_map<TextureKey, Entry, TextureKeyHash> entries;
+    unordered_map<unsigned int, TextureKey> keysById;
+    unordered_set<TextureKey, TextureKeyHash> pending;     // claimed, being decoded or uploaded
+    bool shutDown = false;
+    bool compress = false;
+    bool s3tc = false;
+
+    TextureCache() {}
+};
+#endif
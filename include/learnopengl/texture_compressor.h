@@ -0,0 +1,602 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/filesystem.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Block compression of textures. The first time a texture is loaded its mip chain is built on the CPU, every level
+// is block compressed and the result is written to a KTX (version 1) file in TEXTURE_CACHE_DIRECTORY. Later starts
+// read that file and upload the levels with glCompressedTexImage2D, without decoding the PNG/JPG at all.
+//
+//   color maps            BC1, or BC3 if the image has non-opaque alpha
+//   normal maps           BC5 (x and y; shaders reconstruct z)
+//   specular/height maps  BC4 if the image is grayscale (sampled through a red swizzle), otherwise BC1
+//
+// The encoders fit the endpoints along the principal axis of each block, which is fast and good enough for a first
+// run; the cache file is keyed on the source file's mtime and size, so an edited texture is transcoded again.
+
+// S3TC formats come from EXT_texture_compression_s3tc and EXT_texture_sRGB, which the GL 3.3 core loader doesn't define
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// what the channels of a texture hold, decides its compressed format
+enum Texture_Usage {
+    USAGE_COLOR,
+    USAGE_NORMAL,
+    USAGE_SCALAR
+};
+
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+const char *const TEXTURE_CACHE_DIRECTORY = "resources/cache/textures";
+const char *const TEXTURE_CACHE_KEY = "RGTextureCacheKey";
+const char *const TEXTURE_CACHE_SOURCE_INFO = "RGTextureSourceInfo";
+
+struct CompressedLevel {
+    int width;
+    int height;
+    vector<unsigned char> data;
+};
+
+// a block compressed texture with its complete mip chain
+struct CompressedTexture {
+    GLenum format = 0;
+    int sourceComponents = 0;               // channel count of the source image
+    double sourceDecodeMilliseconds = 0.0;  // how long decoding the source image took when it was transcoded
+    vector<CompressedLevel> levels;
+
+    size_t Bytes() const
+    {
+        size_t bytes = 0;
+        for (const CompressedLevel &level : levels)
+            bytes += level.data.size();
+        return bytes;
+    }
+};
+
+bool IsS3TCFormat(GLenum format)
+{
+    return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+        || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT || format == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+}
+
+const char *CompressedFormatName(GLenum format)
+{
+    switch (format)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: return "BC1";
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: return "BC3";
+        case GL_COMPRESSED_RED_RGTC1: return "BC4";
+        case GL_COMPRESSED_RG_RGTC2: return "BC5";
+    }
+    return "uncompressed";
+}
+
+size_t CompressedBlockBytes(GLenum format)
+{
+    return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+        || format == GL_COMPRESSED_RED_RGTC1 ? 8 : 16;
+}
+
+GLenum CompressedBaseFormat(GLenum format)
+{
+    if (format == GL_COMPRESSED_RED_RGTC1)
+        return GL_RED;
+    if (format == GL_COMPRESSED_RG_RGTC2)
+        return GL_RG;
+    if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT)
+        return GL_RGB;
+    return GL_RGBA;
+}
+
+// whether the driver can sample S3TC textures (BC1/BC3). BC4/BC5 are core since GL 3.0. must run on the GL thread.
+bool S3TCSupported()
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char *name = (const char *) glGetStringi(GL_EXTENSIONS, i);
+        if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+            return true;
+    }
+    return false;
+}
+
+// block encoders, all take 16 pixels of a 4x4 block in RGBA8
+
+uint16_t packColor565(const float color[3])
+{
+    int r = (int) std::lround(std::min(255.0f, std::max(0.0f, color[0])) * 31.0f / 255.0f);
+    int g = (int) std::lround(std::min(255.0f, std::max(0.0f, color[1])) * 63.0f / 255.0f);
+    int b = (int) std::lround(std::min(255.0f, std::max(0.0f, color[2])) * 31.0f / 255.0f);
+    return (uint16_t) (r << 11 | g << 5 | b);
+}
+
+void unpackColor565(uint16_t packed, float color[3])
+{
+    color[0] = ((packed >> 11) & 31) * 255.0f / 31.0f;
+    color[1] = ((packed >> 5) & 63) * 255.0f / 63.0f;
+    color[2] = (packed & 31) * 255.0f / 31.0f;
+}
+
+// 8 bytes: two 565 endpoints on the principal axis of the block's colors and a 2 bit palette index per pixel
+void EncodeBC1Block(const unsigned char *block, unsigned char *out)
+{
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[4 * i + c] / 16.0f;
+    float covariance[6] = {0.0f};   // xx xy xz yy yz zz
+    for (int i = 0; i < 16; i++)
+    {
+        float d[3] = {block[4 * i] - mean[0], block[4 * i + 1] - mean[1], block[4 * i + 2] - mean[2]};
+        covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+    }
+    // power iteration for the principal axis, starting from the covariance row of the channel with the most variance
+    // (a fixed start like gray can be orthogonal to the axis, e.g. when red rises while blue falls)
+    float axis[3] = {covariance[0], covariance[1], covariance[2]};
+    if (covariance[3] >= covariance[0] && covariance[3] >= covariance[5])
+    {
+        axis[0] = covariance[1]; axis[1] = covariance[3]; axis[2] = covariance[4];
+    }
+    else if (covariance[5] >= covariance[0] && covariance[5] >= covariance[3])
+    {
+        axis[0] = covariance[2]; axis[1] = covariance[4]; axis[2] = covariance[5];
+    }
+    float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    for (int c = 0; c < 3; c++)
+        axis[c] = axisLength > 1e-6f ? axis[c] / axisLength : 0.57735f;
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3] = {
+            covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+            covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+            covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+        };
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < 3; c++)
+            t += (block[4 * i + c] - mean[c]) * axis[c];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    float high[3], low[3];
+    for (int c = 0; c < 3; c++)
+    {
+        high[c] = mean[c] + axis[c] * maxT;
+        low[c] = mean[c] + axis[c] * minT;
+    }
+    uint16_t color0 = packColor565(high), color1 = packColor565(low);
+    if (color0 < color1)
+        std::swap(color0, color1);  // color0 > color1 selects the four color mode
+
+    float palette[4][3];
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    uint32_t indices = 0;
+    if (color0 != color1)
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestError = 1e30f;
+            for (int p = 0; p < 4; p++)
+            {
+                float error = 0.0f;
+                for (int c = 0; c < 3; c++)
+                    error += (block[4 * i + c] - palette[p][c]) * (block[4 * i + c] - palette[p][c]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t) best << (2 * i);
+        }
+
+    out[0] = color0 & 0xff; out[1] = color0 >> 8;
+    out[2] = color1 & 0xff; out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// 8 bytes: the channel's min and max and a 3 bit index per pixel into the 8 values between them
+void EncodeBC4Block(const unsigned char *block, int channel, unsigned char *out)
+{
+    unsigned char low = 255, high = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        low = std::min(low, block[4 * i + channel]);
+        high = std::max(high, block[4 * i + channel]);
+    }
+    out[0] = high;
+    out[1] = low;
+
+    uint64_t indices = 0;
+    if (high != low)
+    {
+        // high > low selects the eight value mode: index 0 and 1 are the endpoints, 2..7 interpolate from high to low
+        float palette[8] = {(float) high, (float) low};
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * high + p * low) / 7.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestError = 1e30f;
+            for (int p = 0; p < 8; p++)
+            {
+                float error = std::fabs(block[4 * i + channel] - palette[p]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t) best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// compresses one RGBA8 image, edge blocks repeat the last row/column
+vector<unsigned char> CompressLevel(const vector<unsigned char> &rgba, int width, int height, GLenum format)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t blockBytes = CompressedBlockBytes(format);
+    vector<unsigned char> compressed(blocksX * blocksY * blockBytes);
+    unsigned char block[64];
+    for (int by = 0; by < blocksY; by++)
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            for (int y = 0; y < 4; y++)
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = std::min(bx * 4 + x, width - 1), sy = std::min(by * 4 + y, height - 1);
+                    memcpy(block + 4 * (4 * y + x), &rgba[4 * ((size_t) sy * width + sx)], 4);
+                }
+            unsigned char *out = &compressed[(by * blocksX + bx) * blockBytes];
+            switch (format)
+            {
+                case GL_COMPRESSED_RED_RGTC1:
+                    EncodeBC4Block(block, 0, out);
+                    break;
+                case GL_COMPRESSED_RG_RGTC2:
+                    EncodeBC4Block(block, 0, out);
+                    EncodeBC4Block(block, 1, out + 8);
+                    break;
+                case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+                    EncodeBC4Block(block, 3, out);  // the BC3 alpha block has the same layout as BC4
+                    EncodeBC1Block(block, out + 8);
+                    break;
+                default:
+                    EncodeBC1Block(block, out);
+                    break;
+            }
+        }
+    return compressed;
+}
+
+float srgbToLinear(unsigned char value)
+{
+    static float table[256];
+    static bool initialized = [] {
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return true;
+    }();
+    (void) initialized;
+    return table[value];
+}
+
+unsigned char linearToSrgb(float value)
+{
+    float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char) std::lround(std::min(1.0f, std::max(0.0f, c)) * 255.0f);
+}
+
+// halves an RGBA8 image with a box filter. sRGB colors are averaged in linear space and normals are renormalized.
+vector<unsigned char> DownsampleLevel(const vector<unsigned char> &rgba, int width, int height, Texture_Usage usage, bool srgb)
+{
+    int halfWidth = std::max(1, width / 2), halfHeight = std::max(1, height / 2);
+    vector<unsigned char> half((size_t) halfWidth * halfHeight * 4);
+    for (int y = 0; y < halfHeight; y++)
+        for (int x = 0; x < halfWidth; x++)
+        {
+            const unsigned char *texels[4] = {
+                &rgba[4 * ((size_t) std::min(2 * y, height - 1) * width + std::min(2 * x, width - 1))],
+                &rgba[4 * ((size_t) std::min(2 * y, height - 1) * width + std::min(2 * x + 1, width - 1))],
+                &rgba[4 * ((size_t) std::min(2 * y + 1, height - 1) * width + std::min(2 * x, width - 1))],
+                &rgba[4 * ((size_t) std::min(2 * y + 1, height - 1) * width + std::min(2 * x + 1, width - 1))]
+            };
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (const unsigned char *texel : texels)
+                for (int c = 0; c < 4; c++)
+                {
+                    if (usage == USAGE_NORMAL && c < 3)
+                        sum[c] += texel[c] / 127.5f - 1.0f;
+                    else if (srgb && c < 3)
+                        sum[c] += srgbToLinear(texel[c]);
+                    else
+                        sum[c] += texel[c];
+                }
+
+            unsigned char *out = &half[4 * ((size_t) y * halfWidth + x)];
+            if (usage == USAGE_NORMAL)
+            {
+                float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                for (int c = 0; c < 3; c++)
+                    out[c] = (unsigned char) std::lround((length > 0.0f ? sum[c] / length : (c == 2 ? 1.0f : 0.0f)) * 127.5f + 127.5f);
+            }
+            else
+                for (int c = 0; c < 3; c++)
+                    out[c] = srgb ? linearToSrgb(sum[c] / 4.0f) : (unsigned char) std::lround(sum[c] / 4.0f);
+            out[3] = (unsigned char) std::lround(sum[3] / 4.0f);
+        }
+    return half;
+}
+
+// picks the compressed format for a decoded image, 0 if it stays uncompressed
+GLenum ChooseCompressedFormat(const vector<unsigned char> &rgba, int components, Texture_Usage usage, bool srgb, bool s3tc)
+{
+    if (usage == USAGE_NORMAL)
+        return GL_COMPRESSED_RG_RGTC2;
+
+    bool grayscale = true, opaque = true;
+    for (size_t i = 0; i < rgba.size(); i += 4)
+    {
+        grayscale = grayscale && std::abs(rgba[i] - rgba[i + 1]) <= 2 && std::abs(rgba[i] - rgba[i + 2]) <= 2;
+        opaque = opaque && rgba[i + 3] == 255;
+    }
+    if (usage == USAGE_SCALAR && (grayscale || components == 1))
+        return GL_COMPRESSED_RED_RGTC1;
+    if (!s3tc)
+        return 0;
+    if (components == 4 && !opaque)
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+// builds the mip chain of a decoded image and compresses every level. returns false if the image should stay
+// uncompressed (see ChooseCompressedFormat).
+bool CompressImage(const unsigned char *pixels, int width, int height, int components, Texture_Usage usage, bool srgb,
+                   bool s3tc, CompressedTexture &texture)
+{
+    vector<unsigned char> rgba((size_t) width * height * 4);
+    for (size_t i = 0; i < (size_t) width * height; i++)
+    {
+        const unsigned char *in = pixels + i * components;
+        unsigned char *out = &rgba[4 * i];
+        out[0] = in[0];
+        out[1] = components >= 3 ? in[1] : in[0];
+        out[2] = components >= 3 ? in[2] : in[0];
+        out[3] = components == 4 ? in[3] : (components == 2 ? in[1] : 255);
+    }
+
+    texture.format = ChooseCompressedFormat(rgba, components, usage, srgb, s3tc);
+    if (texture.format == 0)
+        return false;
+    texture.sourceComponents = components;
+    texture.levels.clear();
+    while (true)
+    {
+        CompressedLevel level;
+        level.width = width;
+        level.height = height;
+        level.data = CompressLevel(rgba, width, height, texture.format);
+        texture.levels.push_back(std::move(level));
+        if (width == 1 && height == 1)
+            break;
+        rgba = DownsampleLevel(rgba, width, height, usage, srgb);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return true;
+}
+
+// cache files are named after a hash of everything that changes their content except the source file's state
+string CompressedTexturePath(const string &sourcePath, Texture_Usage usage, bool srgb)
+{
+    std::stringstream name;
+    name << std::hex << std::hash<string>()(sourcePath + "|" + to_string(usage) + "|" + to_string(srgb)) << ".ktx";
+    return FileSystem::getPath(TEXTURE_CACHE_DIRECTORY) + "/" + name.str();
+}
+
+// the cache key stored in the KTX metadata, empty if the source file doesn't exist
+string CompressedTextureKey(const string &sourcePath, Texture_Usage usage, bool srgb, bool s3tc)
+{
+    struct stat sourceStat;
+    if (stat(sourcePath.c_str(), &sourceStat) != 0)
+        return "";
+    std::stringstream key;
+    key << TEXTURE_CACHE_VERSION << " " << sourcePath << " " << (int64_t) sourceStat.st_mtime << " "
+        << (uint64_t) sourceStat.st_size << " " << usage << " " << srgb << " " << s3tc;
+    return key.str();
+}
+
+struct KTXHeader {
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+const unsigned char KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// writes a compressed texture as KTX file, through a temporary file like the mesh cache
+bool WriteCompressedTexture(const string &cachePath, const string &key, const CompressedTexture &texture)
+{
+    mkdir(FileSystem::getPath("resources/cache").c_str(), 0755);
+    mkdir(FileSystem::getPath(TEXTURE_CACHE_DIRECTORY).c_str(), 0755);
+
+    // key/value pairs: uint32 size, "key\0value\0", padded to 4 bytes
+    string keyValueData;
+    auto addKeyValue = [&keyValueData](const string &name, const string &value) {
+        string pair = name + '\0' + value + '\0';
+        uint32_t size = pair.size();
+        keyValueData.append((const char *) &size, sizeof(size));
+        keyValueData += pair;
+        keyValueData.append((4 - pair.size() % 4) % 4, '\0');
+    };
+    addKeyValue(TEXTURE_CACHE_KEY, key);
+    addKeyValue(TEXTURE_CACHE_SOURCE_INFO, to_string(texture.sourceComponents) + " " + to_string(texture.sourceDecodeMilliseconds));
+
+    KTXHeader header;
+    memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    header.endianness = 0x04030201;
+    header.glType = 0;
+    header.glTypeSize = 1;
+    header.glFormat = 0;
+    header.glInternalFormat = texture.format;
+    header.glBaseInternalFormat = CompressedBaseFormat(texture.format);
+    header.pixelWidth = texture.levels[0].width;
+    header.pixelHeight = texture.levels[0].height;
+    header.pixelDepth = 0;
+    header.numberOfArrayElements = 0;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = texture.levels.size();
+    header.bytesOfKeyValueData = keyValueData.size();
+
+    string tmpPath = cachePath + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write((const char *) &header, sizeof(header));
+    out.write(keyValueData.data(), keyValueData.size());
+    for (const CompressedLevel &level : texture.levels)
+    {
+        uint32_t imageSize = level.data.size();    // always a multiple of 8, no mip padding needed
+        out.write((const char *) &imageSize, sizeof(imageSize));
+        out.write((const char *) level.data.data(), level.data.size());
+    }
+    out.close();
+    if (!out || std::rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// reads a KTX file written by WriteCompressedTexture, returns false if it is missing, damaged or has another key
+bool ReadCompressedTexture(const string &cachePath, const string &key, CompressedTexture &texture)
+{
+    std::ifstream in(cachePath, std::ios::binary);
+    if (!in)
+        return false;
+    vector<char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (file.size() < sizeof(KTXHeader))
+        return false;
+
+    KTXHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 || header.endianness != 0x04030201
+        || header.glType != 0 || header.numberOfFaces != 1 || header.numberOfMipmapLevels == 0
+        || header.bytesOfKeyValueData > file.size() - sizeof(KTXHeader))
+        return false;
+
+    size_t offset = sizeof(KTXHeader);
+    size_t keyValueEnd = offset + header.bytesOfKeyValueData;
+    bool keyMatches = false;
+    while (offset + 4 <= keyValueEnd)
+    {
+        uint32_t size;
+        memcpy(&size, &file[offset], sizeof(size));
+        offset += 4;
+        if (size > keyValueEnd - offset)
+            return false;
+        string pair(&file[offset], size);
+        size_t separator = pair.find('\0');
+        string name = pair.substr(0, separator);
+        string value = separator == string::npos ? "" : pair.substr(separator + 1);
+        value = value.substr(0, value.find('\0'));
+        if (name == TEXTURE_CACHE_KEY)
+            keyMatches = value == key;
+        else if (name == TEXTURE_CACHE_SOURCE_INFO)
+            sscanf(value.c_str(), "%d %lf", &texture.sourceComponents, &texture.sourceDecodeMilliseconds);
+        offset += (size + 3) & ~3u;
+    }
+    if (!keyMatches)
+        return false;
+
+    offset = keyValueEnd;
+    texture.format = header.glInternalFormat;
+    texture.levels.clear();
+    int width = header.pixelWidth, height = header.pixelHeight;
+    for (uint32_t i = 0; i < header.numberOfMipmapLevels; i++)
+    {
+        uint32_t imageSize;
+        if (offset + 4 > file.size())
+            return false;
+        memcpy(&imageSize, &file[offset], sizeof(imageSize));
+        offset += 4;
+        size_t expected = (size_t) ((width + 3) / 4) * ((height + 3) / 4) * CompressedBlockBytes(texture.format);
+        if (imageSize != expected || imageSize > file.size() - offset)
+            return false;
+        CompressedLevel level;
+        level.width = width;
+        level.height = height;
+        level.data.assign(file.begin() + offset, file.begin() + offset + imageSize);
+        texture.levels.push_back(std::move(level));
+        offset += (imageSize + 3) & ~3u;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,368 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/texture_compressor.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// how the color channels of a texture are interpreted when sampling
+enum Texture_Colorspace {
+    COLORSPACE_LINEAR,
+    COLORSPACE_SRGB
+};
+
+// sampler wrap mode of a texture. WRAP_CLAMP_IF_ALPHA clamps textures with an alpha channel to avoid semi-transparent
+// borders (interpolation would otherwise take texels from the next repeat) and repeats all others.
+enum Texture_Wrap {
+    WRAP_REPEAT,
+    WRAP_CLAMP_IF_ALPHA
+};
+
+// an image decoded into CPU staging memory, waiting to be uploaded by the GL thread
+struct ImageData {
+    string path;
+    Texture_Colorspace colorspace = COLORSPACE_LINEAR;
+    Texture_Wrap wrap = WRAP_REPEAT;
+    Texture_Usage usage = USAGE_COLOR;
+    bool compress = false;  // block compress through the texture cache directory, see texture_compressor.h
+    bool s3tc = false;      // BC1/BC3 may be used
+    unsigned char *data = nullptr;
+    CompressedTexture compressed;   // filled instead of data for compressed images
+    int width = 0;
+    int height = 0;
+    int nrComponents = 0;
+};
+
+// prints the VRAM and load time of a compressed texture next to what the uncompressed texture would have cost
+void reportCompressedImage(const ImageData &image, bool fromCache, double milliseconds)
+{
+    size_t uncompressedBytes = 0;
+    for (const CompressedLevel &level : image.compressed.levels)
+        uncompressedBytes += (size_t) level.width * level.height * image.nrComponents;
+    std::stringstream report;
+    report << std::fixed << std::setprecision(1) << "Texture " << image.path << ": " << CompressedFormatName(image.compressed.format)
+           << " " << image.width << "x" << image.height << ", " << image.compressed.Bytes() / 1024 << " KB (uncompressed "
+           << uncompressedBytes / 1024 << " KB), " << (fromCache ? "loaded from cache in " : "transcoded in ") << milliseconds
+           << " ms (decoding the source took " << image.compressed.sourceDecodeMilliseconds << " ms)\n";
+    std::cout << report.str() << std::flush;
+}
+
+// decodes a single image into staging memory. safe to call from worker threads, as long as nobody changes
+// the stb_image flip setting while decoding is in progress.
+// with compress set the block compressed copy in the texture cache directory is used, or created from the source.
+void DecodeImage(ImageData &image)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]() { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+    bool srgb = image.colorspace == COLORSPACE_SRGB;
+    string cachePath, key;
+    if (image.compress)
+    {
+        cachePath = CompressedTexturePath(image.path, image.usage, srgb);
+        key = CompressedTextureKey(image.path, image.usage, srgb, image.s3tc);
+        if (!key.empty() && ReadCompressedTexture(cachePath, key, image.compressed))
+        {
+            image.width = image.compressed.levels[0].width;
+            image.height = image.compressed.levels[0].height;
+            image.nrComponents = image.compressed.sourceComponents;
+            reportCompressedImage(image, true, elapsed());
+            return;
+        }
+    }
+
+    image.data = stbi_load(image.path.c_str(), &image.width, &image.height, &image.nrComponents, 0);
+    if (!image.compress || !image.data)
+        return;
+    double decodeMilliseconds = elapsed();
+    if (CompressImage(image.data, image.width, image.height, image.nrComponents, image.usage, srgb, image.s3tc, image.compressed))
+    {
+        image.compressed.sourceDecodeMilliseconds = decodeMilliseconds;
+        stbi_image_free(image.data);
+        image.data = nullptr;
+        if (!key.empty() && !WriteCompressedTexture(cachePath, key, image.compressed))
+            std::cout << "WARNING::TEXTURE_CACHE:: could not write cache for " << image.path << std::endl;
+        reportCompressedImage(image, false, elapsed());
+    }
+}
+
+// Process-wide pool of image decoders, one worker per hardware thread. All model loaders queue their images here,
+// so however many of them run at once, no more images are decoded (and held in staging memory mid-decode) than there
+// are cores. Images are taken from the queue one at a time, so a few big textures don't leave the other workers idle.
+class DecodePool
+{
+public:
+    static DecodePool &Instance()
+    {
+        static DecodePool pool;
+        return pool;
+    }
+
+    // decodes all images and returns once they are done
+    void Decode(vector<ImageData> &images)
+    {
+        if (images.empty())
+            return;
+        Batch batch;
+        batch.remaining = images.size();
+        std::unique_lock<std::mutex> lock(mutex);
+        for (ImageData &image : images)
+            queue.push_back(Job{&image, &batch});
+        workAvailable.notify_all();
+        batchDone.wait(lock, [&batch]() { return batch.remaining == 0; });
+    }
+
+    DecodePool(const DecodePool &) = delete;
+    DecodePool &operator=(const DecodePool &) = delete;
+
+private:
+    struct Batch {
+        size_t remaining;
+    };
+    struct Job {
+        ImageData *image;
+        Batch *batch;
+    };
+
+    std::mutex mutex;
+    std::condition_variable workAvailable, batchDone;
+    std::deque<Job> queue;
+    vector<std::thread> workers;
+    bool stopping = false;
+
+    DecodePool()
+    {
+        unsigned int workerCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < workerCount; i++)
+            workers.emplace_back(&DecodePool::work, this);
+    }
+
+    ~DecodePool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (std::thread &t : workers)
+            t.join();
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            workAvailable.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            Job job = queue.front();
+            queue.pop_front();
+            lock.unlock();
+            DecodeImage(*job.image);
+            lock.lock();
+            if (--job.batch->remaining == 0)
+                batchDone.notify_all();
+        }
+    }
+};
+
+// decodes all images on the shared decode pool, see DecodePool
+void DecodeImagesParallel(vector<ImageData> &images)
+{
+    DecodePool::Instance().Decode(images);
+}
+
+GLenum ImageFormat(const ImageData &image)
+{
+    if (image.nrComponents == 1)
+        return GL_RED;
+    else if (image.nrComponents == 2)
+        return GL_RG;
+    else if (image.nrComponents == 3)
+        return GL_RGB;
+    return GL_RGBA;
+}
+
+GLenum ImageInternalFormat(const ImageData &image)
+{
+    if (image.colorspace == COLORSPACE_SRGB && image.nrComponents == 3)
+        return GL_SRGB;
+    if (image.colorspace == COLORSPACE_SRGB && image.nrComponents == 4)
+        return GL_SRGB_ALPHA;
+    return ImageFormat(image);
+}
+
+void SetTextureParameters(const ImageData &image)
+{
+    GLenum wrap = image.wrap == WRAP_CLAMP_IF_ALPHA && image.nrComponents == 4 ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (!image.compressed.levels.empty())
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.compressed.levels.size() - 1);
+    if (image.compressed.format == GL_COMPRESSED_RED_RGTC1)
+    {
+        // single channel maps were grayscale images, shaders may still read them as .rgb
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+}
+
+// frees the staging memory of an uploaded image
+void releaseImageData(ImageData &image)
+{
+    if (image.data)
+        stbi_image_free(image.data);
+    image.data = nullptr;
+    vector<CompressedLevel>().swap(image.compressed.levels);
+}
+
+// uploads a decoded image to a new mipmapped 2D texture and releases the staging memory. must run on the GL thread.
+unsigned int UploadImage(ImageData &image)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    if (!image.compressed.levels.empty())
+    {
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        for (unsigned int i = 0; i < image.compressed.levels.size(); i++)
+        {
+            const CompressedLevel &level = image.compressed.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, image.compressed.format, level.width, level.height, 0, level.data.size(), level.data.data());
+        }
+        SetTextureParameters(image);
+        releaseImageData(image);
+    }
+    else if (image.data)
+    {
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, ImageInternalFormat(image), image.width, image.height, 0, ImageFormat(image), GL_UNSIGNED_BYTE, image.data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        SetTextureParameters(image);
+        releaseImageData(image);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+    }
+
+    return textureID;
+}
+
+// a decoded image that is uploaded over several frames
+struct StreamedImage {
+    ImageData image;
+    unsigned int id = 0;
+    int uploadedRows = 0;   // or mip levels, for compressed images
+    bool done = false;
+    bool shared = false;    // another loader decodes and uploads it, the texture comes from the texture cache
+};
+
+// copies data into a freshly orphaned PBO, so the transfer doesn't wait for the previous chunk. returns the pointer
+// to pass to the glTex(Sub)Image call: offset 0 into the bound PBO, or the data itself if the PBO couldn't be mapped.
+const void *stageInPixelBuffer(unsigned int pbo, const void *data, size_t bytes)
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!staging)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);    // couldn't map, upload from client memory instead
+        return data;
+    }
+    memcpy(staging, data, bytes);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    return nullptr;
+}
+
+// streams the mip levels of a compressed image, smallest last, at least one level per call
+size_t streamCompressedImage(StreamedImage &texture, unsigned int pbo, size_t byteBudget)
+{
+    ImageData &image = texture.image;
+    const vector<CompressedLevel> &levels = image.compressed.levels;
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    size_t bytes = 0;
+    do
+    {
+        const CompressedLevel &level = levels[texture.uploadedRows];
+        const void *source = stageInPixelBuffer(pbo, level.data.data(), level.data.size());
+        glCompressedTexImage2D(GL_TEXTURE_2D, texture.uploadedRows, image.compressed.format, level.width, level.height, 0, level.data.size(), source);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        bytes += level.data.size();
+        texture.uploadedRows++;
+    } while (texture.uploadedRows < (int) levels.size() && bytes + levels[texture.uploadedRows].data.size() <= byteBudget);
+
+    if (texture.uploadedRows == (int) levels.size())
+    {
+        releaseImageData(image);
+        texture.done = true;
+    }
+    return bytes;
+}
+
+// uploads the next rows of a streamed image through the given pixel buffer object, at most byteBudget bytes (but
+// always at least one row). the texture is allocated on the first call; once the last row is in, the mipmaps are
+// generated and the staging memory is released. returns the number of bytes uploaded.
+size_t StreamImage(StreamedImage &texture, unsigned int pbo, size_t byteBudget)
+{
+    if (texture.done)
+        return 0;
+
+    ImageData &image = texture.image;
+    GLenum format = ImageFormat(image);
+    bool compressed = !image.compressed.levels.empty();
+    if (texture.id == 0)
+    {
+        glGenTextures(1, &texture.id);
+        if (!image.data && !compressed)
+        {
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
+            texture.done = true;
+            return 0;
+        }
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        if (!compressed)
+            glTexImage2D(GL_TEXTURE_2D, 0, ImageInternalFormat(image), image.width, image.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        SetTextureParameters(image);
+    }
+    if (compressed)
+        return streamCompressedImage(texture, pbo, byteBudget);
+
+    size_t rowBytes = (size_t) image.width * image.nrComponents;
+    int rows = std::min<size_t>(std::max<size_t>(1, byteBudget / rowBytes), image.height - texture.uploadedRows);
+    size_t bytes = rows * rowBytes;
+    const void *source = stageInPixelBuffer(pbo, image.data + texture.uploadedRows * rowBytes, bytes);
+
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, texture.uploadedRows, image.width, rows, format, GL_UNSIGNED_BYTE, source);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    texture.uploadedRows += rows;
+    if (texture.uploadedRows == image.height)
+    {
+        glGenerateMipmap(GL_TEXTURE_2D);
+        releaseImageData(image);
+        texture.done = true;
+    }
+    return bytes;
+}
+#endif
@@ -21,9 +21,33 @@ struct DirLight {
     vec3 ambient;
 };
 
+struct Light {
+    vec3 Position;
+    vec3 Color;
+};
+
+// scene lights, shared by all scene shaders (see frame_uniforms.h)
+layout (std140) uniform Lights {
+    PointLight pointLight;
+    DirLight dirLight;
+    Light lights[4];
+    vec3 floorLightPosition;
+};
+
+// per-frame camera data, shared by all scene shaders (see frame_uniforms.h)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 cameraPosition;
+    float time;
+};
+
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    // the same textures when they were moved into texture arrays, MaterialLayers picks the layer
+    sampler2DArray texture_diffuse_array;
+    sampler2DArray texture_specular_array;
 
     float shininess;
     float shininessBP;  // Blinn-Phong shininess
@@ -32,12 +56,24 @@ struct Material {
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+flat in vec4 MaterialLayers;
 
-uniform PointLight pointLight;
 uniform Material material;
-uniform vec3 viewPosition;
 uniform bool blinn;
-uniform DirLight dirLight;
+
+vec4 SampleDiffuse(vec2 texCoords)
+{
+    if (MaterialLayers.x >= 0.0)
+        return texture(material.texture_diffuse_array, vec3(texCoords, MaterialLayers.x));
+    return texture(material.texture_diffuse1, texCoords);
+}
+
+vec4 SampleSpecular(vec2 texCoords)
+{
+    if (MaterialLayers.y >= 0.0)
+        return texture(material.texture_specular_array, vec3(texCoords, MaterialLayers.y));
+    return texture(material.texture_specular1, texCoords);
+}
 
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -63,17 +99,17 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
     // ambient
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
+    vec3 ambient = light.ambient * vec3(SampleDiffuse(TexCoords));
 
     // diffuse component
-    vec4 diffSample = texture(material.texture_diffuse1, TexCoords);
+    vec4 diffSample = SampleDiffuse(TexCoords);
     if(diffSample.a < 0.4) {
         discard;
     }
     vec3 diffuse = light.diffuse * diff * vec3(diffSample);
 
     // specular
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 specular = light.specular * spec * vec3(SampleSpecular(TexCoords).xxx);
 
     ambient *= attenuation;
     diffuse *= attenuation;
@@ -84,11 +120,11 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
     //ambient
-    vec3 ambient = light.ambient * texture(material.texture_diffuse1, TexCoords).rgb;
+    vec3 ambient = light.ambient * SampleDiffuse(TexCoords).rgb;
     //diffuse
     vec3 lightDir = normalize(-light.direction);
     float diff = max(dot(lightDir, normal), 0.0);
-    vec3 diffuse = light.diffuse * diff * texture(material.texture_diffuse1, TexCoords).rgb;
+    vec3 diffuse = light.diffuse * diff * SampleDiffuse(TexCoords).rgb;
     //specular
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = 0.0f;
@@ -101,7 +137,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
         spec = pow(max(dot(viewDir, reflectDir),0.0), material.shininess);
     }
 
-    vec3 specular = light.specular * spec * texture(material.texture_specular1, TexCoords).rgb;
+    vec3 specular = light.specular * spec * SampleSpecular(TexCoords).rgb;
 
     return (ambient + diffuse + specular);
 }
@@ -109,7 +145,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
 void main()
 {
     vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
+    vec3 viewDir = normalize(cameraPosition - FragPos);
     vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir);
     result += CalcDirLight(dirLight, normal, viewDir);
     FragColor = vec4(result, 1.0);
@@ -2,19 +2,36 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// per-instance model matrix of instanced draws, the identity otherwise (see mesh.h)
+layout (location = 5) in mat4 instanceModel;
+// texture array layer per material texture type, -1 where the mesh has a 2D texture bound (see mesh.h)
+layout (location = 9) in vec4 materialLayers;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+flat out vec4 MaterialLayers;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// per-frame camera data, shared by all scene shaders (see frame_uniforms.h)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 cameraPosition;
+    float time;
+};
+
+// packed meshes store positions quantized to their bounding box, full float meshes keep the identity
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionOffset = vec3(0.0);
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    vec3 position = positionOffset + aPos * positionScale;
+    FragPos = vec3(model * instanceModel * vec4(position, 1.0));
     Normal = aNormal;
     TexCoords = aTexCoords;    
+    MaterialLayers = materialLayers;
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
@@ -6,14 +6,48 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+};
+
 struct Light {
     vec3 Position;
     vec3 Color;
 };
 
-uniform Light lights[4];
+// scene lights, shared by all scene shaders (see frame_uniforms.h)
+layout (std140) uniform Lights {
+    PointLight pointLight;
+    DirLight dirLight;
+    Light lights[4];
+    vec3 floorLightPosition;
+};
+
+// per-frame camera data, shared by all scene shaders (see frame_uniforms.h)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 cameraPosition;
+    float time;
+};
+
 uniform sampler2D diffuseTexture;
-uniform vec3 viewPos;
 
 void main()
 {
@@ -23,7 +57,7 @@ void main()
     vec3 ambient = 0.0 * color;
     // lighting
     vec3 lighting = vec3(0.0);
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(cameraPosition - FragPos);
     for(int i = 0; i < 4; i++)
     {
         // diffuse
@@ -7,10 +7,16 @@ out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
 
-uniform mat4 projection;
-uniform mat4 view;
 uniform mat4 model;
 
+// per-frame camera data, shared by all scene shaders (see frame_uniforms.h)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 cameraPosition;
+    float time;
+};
+
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
@@ -0,0 +1,38 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// the level above, twice the size of the one being written
+uniform sampler2D image;
+
+// 13 tap downsample (Jimenez 2014): five overlapping 2x2 box filters, weighted so the center box counts the most.
+// sampling between the texels lets the bilinear filter do the averaging, and the overlap keeps small bright spots
+// from flickering as they move across the texel grid.
+void main()
+{
+    vec2 texel = 1.0 / textureSize(image, 0);
+    float x = texel.x;
+    float y = texel.y;
+
+    vec3 a = texture(image, TexCoords + vec2(-2.0 * x,  2.0 * y)).rgb;
+    vec3 b = texture(image, TexCoords + vec2( 0.0,      2.0 * y)).rgb;
+    vec3 c = texture(image, TexCoords + vec2( 2.0 * x,  2.0 * y)).rgb;
+    vec3 d = texture(image, TexCoords + vec2(-2.0 * x,  0.0)).rgb;
+    vec3 e = texture(image, TexCoords).rgb;
+    vec3 f = texture(image, TexCoords + vec2( 2.0 * x,  0.0)).rgb;
+    vec3 g = texture(image, TexCoords + vec2(-2.0 * x, -2.0 * y)).rgb;
+    vec3 h = texture(image, TexCoords + vec2( 0.0,     -2.0 * y)).rgb;
+    vec3 i = texture(image, TexCoords + vec2( 2.0 * x, -2.0 * y)).rgb;
+    vec3 j = texture(image, TexCoords + vec2(-x,  y)).rgb;
+    vec3 k = texture(image, TexCoords + vec2( x,  y)).rgb;
+    vec3 l = texture(image, TexCoords + vec2(-x, -y)).rgb;
+    vec3 m = texture(image, TexCoords + vec2( x, -y)).rgb;
+
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+    // the bright pass can hold very large values, keep them from turning into NaNs in the 11/10 bit floats
+    FragColor = vec4(max(result, 0.0001), 1.0);
+}
@@ -9,6 +9,7 @@ uniform bool bloom;
 uniform bool hdr;
 uniform bool gamma;
 uniform float exposure;
+uniform float bloomIntensity = 1.0;
 
 void main()
 {
@@ -17,7 +18,7 @@ void main()
     vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
 
     if(bloom) {
-        hdrColor += bloomColor; // additive blending
+        hdrColor += bloomColor * bloomIntensity; // additive blending
     }
 
     vec3 result = hdrColor;
@@ -0,0 +1,31 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// the level below, half the size of the one being written to (additively)
+uniform sampler2D image;
+// reach of the filter in texture coordinates, wider for a softer bloom
+uniform vec2 filterRadius;
+
+// 3x3 tent filter upsample (Jimenez 2014), the result is added onto the level being written
+void main()
+{
+    float x = filterRadius.x;
+    float y = filterRadius.y;
+
+    vec3 a = texture(image, TexCoords + vec2(-x,  y)).rgb;
+    vec3 b = texture(image, TexCoords + vec2( 0.0, y)).rgb;
+    vec3 c = texture(image, TexCoords + vec2( x,  y)).rgb;
+    vec3 d = texture(image, TexCoords + vec2(-x,  0.0)).rgb;
+    vec3 e = texture(image, TexCoords).rgb;
+    vec3 f = texture(image, TexCoords + vec2( x,  0.0)).rgb;
+    vec3 g = texture(image, TexCoords + vec2(-x, -y)).rgb;
+    vec3 h = texture(image, TexCoords + vec2( 0.0, -y)).rgb;
+    vec3 i = texture(image, TexCoords + vec2( x, -y)).rgb;
+
+    vec3 result = e * 4.0;
+    result += (b + d + f + h) * 2.0;
+    result += (a + c + g + i);
+    FragColor = vec4(result / 16.0, 1.0);
+}
@@ -0,0 +1,67 @@
+#version 430 core
+// COMPUTE_BLUR_TILE
+layout (local_size_x = 16, local_size_y = 16) in;
+
+const int TILE = 16;
+// BLUR_MAX_RADIUS, the widest apron around the tile
+const int MAX_RADIUS = 16;
+const int MAX_SIDE = TILE + 2 * MAX_RADIUS;
+
+uniform sampler2D image;
+layout (rgba16f, binding = 0) uniform writeonly image2D result;
+
+// Gaussian kernel generated on the CPU (blur_kernel.h), one weight per texel from the center out
+uniform int radius;
+uniform float texelWeights[MAX_RADIUS + 1];
+
+// the tile with its apron, and the apron's rows blurred horizontally for the tile's columns. rgb is kept as half
+// floats, which is what the bloom targets hold anyway, to fit the largest apron into 24 KB.
+shared uvec2 tile[MAX_SIDE * MAX_SIDE];
+shared uvec2 rows[MAX_SIDE * TILE];
+
+uvec2 packColor(vec3 color)
+{
+    return uvec2(packHalf2x16(color.rg), packHalf2x16(vec2(color.b, 0.0)));
+}
+
+vec3 unpackColor(uvec2 color)
+{
+    return vec3(unpackHalf2x16(color.x), unpackHalf2x16(color.y).x);
+}
+
+void main()
+{
+    ivec2 size = textureSize(image, 0);
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * TILE;
+    int side = TILE + 2 * radius;
+    int thread = int(gl_LocalInvocationIndex);
+
+    // 1. the tile and its apron, clamped to the edge like the fragment blur's textures
+    for (int i = thread; i < side * side; i += TILE * TILE)
+    {
+        ivec2 texel = clamp(origin - radius + ivec2(i % side, i / side), ivec2(0), size - 1);
+        tile[i] = packColor(texelFetch(image, texel, 0).rgb);
+    }
+    barrier();
+
+    // 2. horizontal pass over every row of the apron, for the tile's columns
+    for (int i = thread; i < side * TILE; i += TILE * TILE)
+    {
+        int center = (i / TILE) * side + i % TILE + radius;
+        vec3 sum = unpackColor(tile[center]) * texelWeights[0];
+        for (int k = 1; k <= radius; k++)
+            sum += (unpackColor(tile[center - k]) + unpackColor(tile[center + k])) * texelWeights[k];
+        rows[i] = packColor(sum);
+    }
+    barrier();
+
+    // 3. vertical pass, one texel per invocation
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    int center = (local.y + radius) * TILE + local.x;
+    vec3 sum = unpackColor(rows[center]) * texelWeights[0];
+    for (int k = 1; k <= radius; k++)
+        sum += (unpackColor(rows[center - k * TILE]) + unpackColor(rows[center + k * TILE])) * texelWeights[k];
+    ivec2 texel = origin + local;
+    if (all(lessThan(texel, size)))
+        imageStore(result, texel, vec4(sum, 1.0));
+}
\ No newline at end of file
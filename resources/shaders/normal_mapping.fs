@@ -15,8 +15,6 @@ uniform sampler2D depthMap;
 
 uniform float heightScale;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
 uniform bool gamma;
 
 vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
@@ -71,10 +69,10 @@ void main()
     if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
         discard;
 
-     // obtain normal from normal map in range [0,1]
-    vec3 normal = texture(normalMap, fs_in.TexCoords).rgb;
-    // transform normal vector to range [-1,1]
-    normal = normalize(normal * 2.0 - 1.0);  // this normal is in tangent space
+     // obtain normal from normal map in range [0,1], only x and y: compressed normal maps store two channels
+    vec2 normalXY = texture(normalMap, fs_in.TexCoords).rg * 2.0 - 1.0;
+    // transform normal vector to range [-1,1], z is always positive in tangent space
+    vec3 normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));  // this normal is in tangent space
 
     // get diffuse color
     vec3 color = texture(diffuseMap, fs_in.TexCoords).rgb;
@@ -13,12 +13,48 @@ out VS_OUT {
     vec3 TangentFragPos;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
 uniform mat4 model;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+// per-frame camera data, shared by all scene shaders (see frame_uniforms.h)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 cameraPosition;
+    float time;
+};
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+};
+
+struct Light {
+    vec3 Position;
+    vec3 Color;
+};
+
+// scene lights, shared by all scene shaders (see frame_uniforms.h)
+layout (std140) uniform Lights {
+    PointLight pointLight;
+    DirLight dirLight;
+    Light lights[4];
+    vec3 floorLightPosition;
+};
 
 void main()
 {
@@ -30,8 +66,8 @@ void main()
     vec3 N = normalize(mat3(model) * aNormal);
     mat3 TBN = transpose(mat3(T, B, N));
 
-    vs_out.TangentLightPos = TBN * lightPos;
-    vs_out.TangentViewPos  = TBN * viewPos;
+    vs_out.TangentLightPos = TBN * floorLightPosition;
+    vs_out.TangentViewPos  = TBN * cameraPosition;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
 
     gl_Position = projection * view * model * vec4(aPos, 1.0);
@@ -0,0 +1,6 @@
+#version 330 core
+
+// occlusion query boxes only go through the depth test, color and depth writes are off
+void main()
+{
+}
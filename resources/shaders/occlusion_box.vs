@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// the box as center and half extents, aPos is a corner of the unit cube [-1, 1]
+uniform vec3 boxCenter;
+uniform vec3 boxExtent;
+
+// per-frame camera data, shared by all scene shaders (see frame_uniforms.h)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 cameraPosition;
+    float time;
+};
+
+void main()
+{
+    gl_Position = projection * view * vec4(boxCenter + aPos * boxExtent, 1.0);
+}
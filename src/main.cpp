@@ -9,12 +9,29 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <learnopengl/bloom_mip_chain.h>
+#include <learnopengl/blur_kernel.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/frame_graph.h>
+#include <learnopengl/frame_uniforms.h>
+#include <learnopengl/gpu_timer.h>
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/compute_blur.h>
+#include <learnopengl/dynamic_resolution.h>
 #include <learnopengl/model.h>
-
+#include <learnopengl/model_streamer.h>
+#include <learnopengl/occlusion_culler.h>
+#include <learnopengl/ping_pong_blur.h>
+#include <learnopengl/render_stats.h>
+#include <learnopengl/scene_bvh.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <random>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
@@ -23,17 +40,50 @@ void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
 unsigned int loadCubemap(vector<std::string> faces);
-unsigned int loadTexture(char const *path);
+unsigned int loadTexture(char const *path, Texture_Usage usage = USAGE_COLOR);
 unsigned int loadTexture(char const * path, bool gammaCorrection);
 
 void renderQuad();
 void renderFloor();
 void renderCube();
+void benchmarkCulling(const glm::mat4 &viewProjection);
+void benchmarkBlur(unsigned int brightTexture, unsigned int brightWidth, unsigned int brightHeight, Shader &blurShader,
+                   Shader *computeBlurShader);
 
 // screen size constants
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
+// model loading: import the models on background threads and stream them in while the render loop runs
+const bool ASYNC_MODEL_LOADING = true;
+const size_t STREAMING_BYTES_PER_FRAME = 8 * 1024 * 1024;
+// store model vertices in the compact 20 byte layout instead of full floats
+const bool PACKED_VERTICES = true;
+// block compress textures, cached in resources/cache/textures
+const bool COMPRESSED_TEXTURES = true;
+// how many pixels a model LOD may deviate from the full detail mesh on screen
+const float LOD_PIXEL_ERROR = 1.0f;
+// skip the model meshes outside of the view frustum
+const bool FRUSTUM_CULLING = true;
+// draw the render queue with glMultiDrawElementsIndirect when the context is GL 4.3 or newer
+const bool INDIRECT_DRAWING = true;
+// copy the model textures into texture arrays, so meshes with different textures can share a draw
+const bool TEXTURE_ARRAYS = true;
+// bloom over a chain of downsampled targets: levels below half resolution, upsampling filter reach as a fraction of
+// the screen height (at the default bloom radius), and the strength of the bloom in the final image
+const unsigned int BLOOM_LEVELS = 6;
+const float BLOOM_RADIUS = 0.005f;
+const float BLOOM_INTENSITY = 1.0f;
+// radius in texels of the Gaussian blurs at startup, changed with - and =; scales the mip chain's filter too
+const unsigned int BLOOM_BLUR_RADIUS = 4;
+// horizontal and vertical pass pairs of the Gaussian blurs
+const unsigned int BLOOM_BLUR_ITERATIONS = 5;
+// render the scene below the window resolution when the GPU frame time goes over the budget, the composite scales it
+// back up; toggled with R
+const bool DYNAMIC_RESOLUTION = true;
+const float GPU_FRAME_BUDGET_MS = 1000.0f / 60.0f;
+const float DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+
 // parallex mapping
 float heightScale = 0.1f;
 
@@ -44,9 +94,29 @@ bool hdr = false;
 bool hdrKeyPressed = false;
 bool bloom = true;
 bool bloomKeyPressed = false;
+// how the bloom is blurred, switched with M. the compute blur needs GL 4.3
+enum BloomBlur { BLOOM_PING_PONG, BLOOM_MIP_CHAIN, BLOOM_COMPUTE, BLOOM_BLUR_COUNT };
+const char *BLOOM_BLUR_NAMES[BLOOM_BLUR_COUNT] = {"ping-pong", "mip chain", "compute"};
+BloomBlur bloomBlur = BLOOM_MIP_CHAIN;
+bool bloomBlurKeyPressed = false;
+unsigned int bloomRadius = BLOOM_BLUR_RADIUS;
+bool bloomRadiusKeyPressed = false;
 float exposure = 1.0f;
 bool gammaOn = false;
 bool gammaKeyPressed = false;
+bool cullingBenchmarkRequested = false;
+bool blurBenchmarkRequested = false;
+bool occlusionCulling = true;
+bool occlusionKeyPressed = false;
+bool dynamicResolution = DYNAMIC_RESOLUTION;
+bool dynamicResolutionKeyPressed = false;
+
+// handles of the scene objects in the scene BVH
+struct SceneObjectHandles {
+    unsigned int castle = 0, rock = 0, quidditch = 0, griffin = 0;
+    unsigned int snitch = 0, phoenix = 0, nimbus = 0;
+    vector<unsigned int> trees, mapleTrees, lightCubes;
+};
 
 // camera
 float lastX = SCR_WIDTH / 2.0f;
@@ -161,6 +231,13 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // the context is asked for 3.3 but is usually newer, the multi-draw path is picked if it is at least 4.3
+    if (INDIRECT_DRAWING && LoadIndirectDrawing((GLADloadproc) glfwGetProcAddress))
+        std::cout << "OpenGL " << GLVersion.major << "." << GLVersion.minor << ": multi-draw indirect render path" << std::endl;
+    else
+        std::cout << "OpenGL " << GLVersion.major << "." << GLVersion.minor << ": per-draw render path" << std::endl;
+    if (LoadComputeBlur((GLADloadproc) glfwGetProcAddress))
+        std::cout << "Compute shader bloom blur available" << std::endl;
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
@@ -194,299 +271,492 @@ int main() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // build and compile shaders
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
-    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
-    Shader shader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
-    Shader shaderLight("resources/shaders/bloom.vs", "resources/shaders/light_box.fs");                 // renderuje kocke izvore svetlosti
-    Shader shaderBlur("resources/shaders/blur.vs", "resources/shaders/blur.fs");                        // primenjuje blur efekat na
-    Shader shaderBloomFinal("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs");    // sve što napravimo renderuje na sam ekran
-    Shader normalShader("resources/shaders/normal_mapping.vs", "resources/shaders/normal_mapping.fs");
-
-    // loading all textures
-    unsigned int diffuseMap = loadTexture(FileSystem::getPath("resources/textures/floor.png").c_str());
-    unsigned int diffuseMapGamma = loadTexture(FileSystem::getPath("resources/textures/floor.png").c_str(), true);
-    unsigned int normalMap  = loadTexture(FileSystem::getPath("resources/textures/floor_normal.png").c_str());
-    unsigned int heightMap  = loadTexture(FileSystem::getPath("resources/textures/floor_displacement.png").c_str());
-
-    // loading all models
-    // floating rock model
-    Model rockModel(FileSystem::getPath("resources/objects/floating-rock/scene.gltf"));
-    rockModel.SetShaderTextureNamePrefix("material.");
-
-    // quidditch model
-    Model quidditchModel(FileSystem::getPath("resources/objects/quidditch/quidditch.obj"));
-    quidditchModel.SetShaderTextureNamePrefix("material.");
-
-    // golden snitch model
-    Model goldenSnitchModel(FileSystem::getPath("resources/objects/golden-snitch/scene.gltf"));
-    goldenSnitchModel.SetShaderTextureNamePrefix("material.");
-
-    // castle model
-    Model castleModel(FileSystem::getPath("resources/objects/castle_v2/scene.gltf"));
-    castleModel.SetShaderTextureNamePrefix("material.");
-
-    // phoenix model
-    Model phoenixModel(FileSystem::getPath("resources/objects/phoenix/scene.gltf"));
-    phoenixModel.SetShaderTextureNamePrefix("material.");
-
-    // griffin model
-    Model griffinModel(FileSystem::getPath("resources/objects/griffin/scene.gltf"));
-    griffinModel.SetShaderTextureNamePrefix("material.");
-
-    // maple tree model
-    Model mapleTreeModel(FileSystem::getPath("resources/objects/maple-tree/scene.gltf"));
-    mapleTreeModel.SetShaderTextureNamePrefix("material.");
-
-    // nimbus
-    Model nimbusModel(FileSystem::getPath("resources/objects/nimbus/scene.gltf"));
-    nimbusModel.SetShaderTextureNamePrefix("material.");
-
-    // tree
-    Model treeModel(FileSystem::getPath("resources/objects/tree/scene.gltf"));
-    treeModel.SetShaderTextureNamePrefix("material.");
-
-    // skybox setup
-    float skyboxVertices[] = {
-            -1.0f,  1.0f, -1.0f,
-            -1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            -1.0f,  1.0f, -1.0f,
-            1.0f,  1.0f, -1.0f,
-            1.0f,  1.0f,  1.0f,
-            1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-            1.0f, -1.0f, -1.0f,
-            1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-            1.0f, -1.0f,  1.0f
-    };
+    // everything that owns GL objects lives in this scope, so it is deleted before the context goes away
+    {
+        // build and compile shaders
+        Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+        Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
+        Shader shader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
+        Shader shaderLight("resources/shaders/bloom.vs", "resources/shaders/light_box.fs");                 // renderuje kocke izvore svetlosti
+        Shader shaderBlur("resources/shaders/blur.vs", "resources/shaders/blur.fs");                        // primenjuje blur efekat na
+        Shader shaderBloomFinal("resources/shaders/bloom_final.vs", "resources/shaders/bloom_final.fs");    // sve što napravimo renderuje na sam ekran
+        Shader shaderBloomDownsample("resources/shaders/blur.vs", "resources/shaders/bloom_downsample.fs");
+        Shader shaderBloomUpsample("resources/shaders/blur.vs", "resources/shaders/bloom_upsample.fs");
+        Shader normalShader("resources/shaders/normal_mapping.vs", "resources/shaders/normal_mapping.fs");
+        Shader occlusionShader("resources/shaders/occlusion_box.vs", "resources/shaders/occlusion_box.fs");
+
+        // camera and lights, shared by the scene shaders through uniform blocks
+        FrameUniforms frameUniforms;
+        RenderQueue renderQueue;
+        for (Shader *sceneShader : {&ourShader, &skyboxShader, &shader, &shaderLight, &normalShader, &occlusionShader})
+            BindFrameUniformBlocks(*sceneShader);
+
+        // loading all textures
+        TextureCache::Instance().EnableCompression(COMPRESSED_TEXTURES);
+        UseTextureArrays() = TEXTURE_ARRAYS;
+        unsigned int diffuseMap = loadTexture(FileSystem::getPath("resources/textures/floor.png").c_str());
+        unsigned int diffuseMapGamma = loadTexture(FileSystem::getPath("resources/textures/floor.png").c_str(), true);
+        unsigned int normalMap  = loadTexture(FileSystem::getPath("resources/textures/floor_normal.png").c_str(), USAGE_NORMAL);
+        unsigned int heightMap  = loadTexture(FileSystem::getPath("resources/textures/floor_displacement.png").c_str(), USAGE_SCALAR);
+
+        // the skybox is loaded without flipping. the flip setting of stb_image is global, so this has to happen
+        // before the models start decoding their textures on other threads.
+        vector<std::string> faces
+                {
+                        FileSystem::getPath("resources/textures/skybox/right.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/left.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/top.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/bottom.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/front.jpg"),
+                        FileSystem::getPath("resources/textures/skybox/back.jpg")
+                };
+
+        stbi_set_flip_vertically_on_load(false);
+        unsigned int cubemapTexture = loadCubemap(faces);
+        stbi_set_flip_vertically_on_load(true);
+
+        // loading all models
+        double modelLoadStart = glfwGetTime();
+        Model_Loading modelLoading = ASYNC_MODEL_LOADING ? LOAD_ASYNC : LOAD_BLOCKING;
+        Vertex_Format vertexFormat = PACKED_VERTICES ? VERTEX_PACKED : VERTEX_FULL;
+        // floating rock model
+        Model rockModel(FileSystem::getPath("resources/objects/floating-rock/scene.gltf"), false, modelLoading, vertexFormat);
+
+        // quidditch model
+        Model quidditchModel(FileSystem::getPath("resources/objects/quidditch/quidditch.obj"), false, modelLoading, vertexFormat);
+
+        // golden snitch model
+        Model goldenSnitchModel(FileSystem::getPath("resources/objects/golden-snitch/scene.gltf"), false, modelLoading, vertexFormat);
+
+        // castle model
+        Model castleModel(FileSystem::getPath("resources/objects/castle_v2/scene.gltf"), false, modelLoading, vertexFormat);
+
+        // phoenix model
+        Model phoenixModel(FileSystem::getPath("resources/objects/phoenix/scene.gltf"), false, modelLoading, vertexFormat);
+
+        // griffin model
+        Model griffinModel(FileSystem::getPath("resources/objects/griffin/scene.gltf"), false, modelLoading, vertexFormat);
+
+        // maple tree model
+        Model mapleTreeModel(FileSystem::getPath("resources/objects/maple-tree/scene.gltf"), false, modelLoading, vertexFormat);
 
-    // skybox VAO
-    unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-
-    vector<std::string> faces
-            {
-                    FileSystem::getPath("resources/textures/skybox/right.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/left.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/top.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/bottom.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/front.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/back.jpg")
-            };
+        // nimbus
+        Model nimbusModel(FileSystem::getPath("resources/objects/nimbus/scene.gltf"), false, modelLoading, vertexFormat);
+
+        // tree
+        Model treeModel(FileSystem::getPath("resources/objects/tree/scene.gltf"), false, modelLoading, vertexFormat);
+
+        Model *sceneModels[] = {&rockModel, &quidditchModel, &goldenSnitchModel, &castleModel, &phoenixModel,
+                                &griffinModel, &mapleTreeModel, &nimbusModel, &treeModel};
+        ModelStreamer modelStreamer(STREAMING_BYTES_PER_FRAME);
+        for (Model *sceneModel : sceneModels)
+            modelStreamer.Add(*sceneModel);
+        bool sceneLoaded = false;
+        bool firstFramePresented = false;
+        float lastStatsUpdate = 0.0f;
+
+        // skybox setup
+        float skyboxVertices[] = {
+                -1.0f,  1.0f, -1.0f,
+                -1.0f, -1.0f, -1.0f,
+                1.0f, -1.0f, -1.0f,
+                1.0f, -1.0f, -1.0f,
+                1.0f,  1.0f, -1.0f,
+                -1.0f,  1.0f, -1.0f,
+
+                -1.0f, -1.0f,  1.0f,
+                -1.0f, -1.0f, -1.0f,
+                -1.0f,  1.0f, -1.0f,
+                -1.0f,  1.0f, -1.0f,
+                -1.0f,  1.0f,  1.0f,
+                -1.0f, -1.0f,  1.0f,
+
+                1.0f, -1.0f, -1.0f,
+                1.0f, -1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f, -1.0f,
+                1.0f, -1.0f, -1.0f,
+
+                -1.0f, -1.0f,  1.0f,
+                -1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f, -1.0f,  1.0f,
+                -1.0f, -1.0f,  1.0f,
+
+                -1.0f,  1.0f, -1.0f,
+                1.0f,  1.0f, -1.0f,
+                1.0f,  1.0f,  1.0f,
+                1.0f,  1.0f,  1.0f,
+                -1.0f,  1.0f,  1.0f,
+                -1.0f,  1.0f, -1.0f,
+
+                -1.0f, -1.0f, -1.0f,
+                -1.0f, -1.0f,  1.0f,
+                1.0f, -1.0f, -1.0f,
+                1.0f, -1.0f, -1.0f,
+                -1.0f, -1.0f,  1.0f,
+                1.0f, -1.0f,  1.0f
+        };
 
-    stbi_set_flip_vertically_on_load(false);
-    unsigned int cubemapTexture = loadCubemap(faces);
-    stbi_set_flip_vertically_on_load(true);
+        // skybox VAO
+        unsigned int skyboxVAO, skyboxVBO;
+        glGenVertexArrays(1, &skyboxVAO);
+        glGenBuffers(1, &skyboxVBO);
+        glBindVertexArray(skyboxVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-    skyboxShader.use();
-    skyboxShader.setInt("skybox", 0);
+        skyboxShader.use();
+        skyboxShader.setInt("skybox", 0);
 
-    // draw in wireframe
+        // draw in wireframe
 //    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    PointLight& pointLight = programState->pointLight;
-    pointLight.position = glm::vec3(4.0f, 4.0, 4.0);
-    pointLight.ambient = glm::vec3(0.5, 0.5, 0.5);
-    pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
-    pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
-    pointLight.constant = 1.0f;
-    pointLight.linear = 0.0f;
-    pointLight.quadratic = 0.0f;
-
-    DirLight& dirLight = programState->dirLight;
-    dirLight.direction = glm::vec3(-4.0f, 0.0f, 0.0f);
-    dirLight.ambient = glm::vec3(0.05f);
-    dirLight.diffuse = glm::vec3(0.4f);
-    dirLight.specular = glm::vec3(0.5f);
-
-    // lıght boxes positions
-    std::vector<glm::vec3> lightPositions;
-    lightPositions.push_back(glm::vec3(-6.0f, 4.5f, -5.6f));
-    lightPositions.push_back(glm::vec3(-2.0f, 4.5f, -7.3f));
-    lightPositions.push_back(glm::vec3(2.0f, 4.5f, -7.2f));
-    lightPositions.push_back(glm::vec3(6.0f, 4.5f, -5.0f));
-
-    // colors
-    std::vector<glm::vec3> lightColors;
-    lightColors.push_back(glm::vec3(5.0f, 5.0f, 5.0f));
-    lightColors.push_back(glm::vec3(5.0f, 5.0f, 5.0f));
-    lightColors.push_back(glm::vec3(5.0f, 5.0f, 5.0f));
-    lightColors.push_back(glm::vec3(5.0f, 5.0f, 5.0f));
-
-    // trees positions
-    std::vector<glm::vec3> treePositions;
-    treePositions.push_back(glm::vec3(-9.0f, -3.52f, -3.8f));
-    treePositions.push_back(glm::vec3(-7.0f, -3.52f, -4.1f));
-    treePositions.push_back(glm::vec3(-9.7f, -3.52f, -0.8f));
-    treePositions.push_back(glm::vec3(-11.3f, -3.52f, -0.8f));
-    treePositions.push_back(glm::vec3(-9.1f, -3.52f, -1.5f));
-    treePositions.push_back(glm::vec3(-11.4f, -3.52f, -4.3f));
-
-    // configure (floating point) framebuffers
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-
-    // create 2 floating point color buffers (1 for normal rendering, other for brightness threshold values - FragColor and BrightColor)
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
-    }
+        PointLight& pointLight = programState->pointLight;
+        pointLight.position = glm::vec3(4.0f, 4.0, 4.0);
+        pointLight.ambient = glm::vec3(0.5, 0.5, 0.5);
+        pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
+        pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
+        pointLight.constant = 1.0f;
+        pointLight.linear = 0.0f;
+        pointLight.quadratic = 0.0f;
+
+        DirLight& dirLight = programState->dirLight;
+        dirLight.direction = glm::vec3(-4.0f, 0.0f, 0.0f);
+        dirLight.ambient = glm::vec3(0.05f);
+        dirLight.diffuse = glm::vec3(0.4f);
+        dirLight.specular = glm::vec3(0.5f);
+
+        // lıght boxes positions
+        std::vector<glm::vec3> lightPositions;
+        lightPositions.push_back(glm::vec3(-6.0f, 4.5f, -5.6f));
+        lightPositions.push_back(glm::vec3(-2.0f, 4.5f, -7.3f));
+        lightPositions.push_back(glm::vec3(2.0f, 4.5f, -7.2f));
+        lightPositions.push_back(glm::vec3(6.0f, 4.5f, -5.0f));
+
+        // colors
+        std::vector<glm::vec3> lightColors;
+        lightColors.push_back(glm::vec3(5.0f, 5.0f, 5.0f));
+        lightColors.push_back(glm::vec3(5.0f, 5.0f, 5.0f));
+        lightColors.push_back(glm::vec3(5.0f, 5.0f, 5.0f));
+        lightColors.push_back(glm::vec3(5.0f, 5.0f, 5.0f));
+
+        // trees positions
+        std::vector<glm::vec3> treePositions;
+        treePositions.push_back(glm::vec3(-9.0f, -3.52f, -3.8f));
+        treePositions.push_back(glm::vec3(-7.0f, -3.52f, -4.1f));
+        treePositions.push_back(glm::vec3(-9.7f, -3.52f, -0.8f));
+        treePositions.push_back(glm::vec3(-11.3f, -3.52f, -0.8f));
+        treePositions.push_back(glm::vec3(-9.1f, -3.52f, -1.5f));
+        treePositions.push_back(glm::vec3(-11.4f, -3.52f, -4.3f));
+
+        // maple trees positions
+        std::vector<glm::vec3> mapleTreePositions;
+        mapleTreePositions.push_back(glm::vec3(-6.0f, 2.0f, -5.6f));
+        mapleTreePositions.push_back(glm::vec3(-2.0f, 2.0f, -7.3f));
+        mapleTreePositions.push_back(glm::vec3(2.0f, 2.0f, -7.2f));
+        mapleTreePositions.push_back(glm::vec3(6.0f, 2.0f, -5.0f));
+
+        // the trees don't move, so their model matrices are built once and every kind is drawn instanced
+        std::vector<glm::mat4> treeInstances, mapleTreeInstances;
+        for (const glm::vec3 &position : treePositions) {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, position);
+            model = glm::scale(model, glm::vec3(0.13f));
+            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
+            treeInstances.push_back(model);
+        }
+        for (const glm::vec3 &position : mapleTreePositions) {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, position);
+            model = glm::scale(model, glm::vec3(0.05f));
+            mapleTreeInstances.push_back(model);
+        }
 
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
+        // the other models that don't move
+        glm::mat4 castleMatrix = glm::mat4(1.0f);
+        castleMatrix = glm::translate(castleMatrix, glm::vec3(0.0f, 2.0f, 0.0f));         // koordinate (x, y, z): y - vertikalna osa
+        castleMatrix = glm::scale(castleMatrix, glm::vec3(0.3f));
+        castleMatrix = glm::rotate(castleMatrix, glm::radians(90.0f), glm::vec3(-1.0, 0.0, 0.0));
+
+        glm::mat4 rockMatrix = glm::mat4(1.0f);
+        rockMatrix = glm::translate(rockMatrix, glm::vec3(-16.0f, 55.25f, -11.0f));
+        rockMatrix = glm::scale(rockMatrix, glm::vec3(0.37f));
+        rockMatrix = glm::rotate(rockMatrix, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
+
+        glm::mat4 quidditchMatrix = glm::mat4(1.0f);
+        quidditchMatrix = glm::translate(quidditchMatrix, glm::vec3(-1.5f, -10.0f, -6.0f));
+        quidditchMatrix = glm::scale(quidditchMatrix, glm::vec3(0.068f));
+        quidditchMatrix = glm::rotate(quidditchMatrix, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
+
+        glm::mat4 griffinMatrix = glm::mat4(1.0f);
+        griffinMatrix = glm::translate(griffinMatrix, glm::vec3(5.0f, 2.2f, 5.5f));
+        griffinMatrix = glm::scale(griffinMatrix, glm::vec3(0.05f));
+        griffinMatrix = glm::rotate(griffinMatrix, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
+
+        // scene BVH over the world space boxes of the model instances and light cubes. the boxes of the models are only
+        // known once they are loaded, so the BVH is built then; until that everything is drawn.
+        SceneBVH sceneBvh;
+        SceneObjectHandles sceneObjects;
+        std::vector<unsigned char> objectVisible;
+        std::vector<glm::mat4> visibleTrees, visibleMapleTrees;
+        // hardware occlusion queries against the boxes of the BVH objects, toggled with O
+        OcclusionCuller occlusionCuller(occlusionShader);
+
+        // the render targets of the frame graph: the floating point scene color, its bright parts and depth, and the
+        // ping-pong blur targets, shared between passes whose lifetimes don't overlap
+        RenderTargetPool renderTargets;
+        std::string lastFrameGraph;
+
+        // fragment shader blur over the frame graph's targets, and the compute shader blur where the context has one
+        PingPongBlur pingPongBlur(shaderBlur);
+        std::unique_ptr<Shader> shaderComputeBlur;
+        std::unique_ptr<ComputeBlur> computeBlur;
+        if (ComputeBlurSupported()) {
+            shaderComputeBlur.reset(new Shader("resources/shaders/blur.cs"));
+            computeBlur.reset(new ComputeBlur(*shaderComputeBlur, SCR_WIDTH, SCR_HEIGHT));
+        }
 
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+        // downsampled targets for the mip chain bloom, the default blur. the GPU time of every blur is measured to compare
+        // them.
+        BloomMipChain bloomMipChain(shaderBloomDownsample, shaderBloomUpsample, SCR_WIDTH, SCR_HEIGHT, BLOOM_LEVELS);
+        GpuTimer bloomTimers[BLOOM_BLUR_COUNT];
+        double bloomMilliseconds[BLOOM_BLUR_COUNT] = {};
+
+        // the scene's targets follow the framebuffer size times the dynamic resolution scale, picked from the GPU time of
+        // the frame graph
+        DynamicResolution resolutionController(GPU_FRAME_BUDGET_MS, DYNAMIC_RESOLUTION_MIN_SCALE);
+        GpuTimer frameTimer;
+        double frameMilliseconds = 0.0;
+        unsigned int renderWidth = SCR_WIDTH, renderHeight = SCR_HEIGHT;
+
+        // shader configuration
+        SetMaterialSamplerUnits(ourShader, "material.");
+
+        shader.use();
+        shader.setInt("diffuseTexture", 0);
 
-    // shader configuration
-    shader.use();
-    shader.setInt("diffuseTexture", 0);
-
-    shaderBlur.use();
-    shaderBlur.setInt("image", 0);
-
-    shaderBloomFinal.use();
-    shaderBloomFinal.setInt("scene", 0);
-    shaderBloomFinal.setInt("bloomBlur", 1);
-
-    normalShader.use();
-    normalShader.setInt("diffuseMap", 0);
-    normalShader.setInt("normalMap", 1);
-    normalShader.setInt("depthMap", 2);
-
-    // lighting info
-    glm::vec3 lightPos(-2.0f, 3.0f, -9.3f);
-
-    // render loop
-    while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-        float yCircle = cos(currentFrame);
-        float zCircle = sin(currentFrame);
-
-        // input
-        processInput(window);
-
-        // render
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        ourShader.use();
-        //pointLight.position = glm::vec3(4.0 * yCircle, 4.0f, 4.0 * zCircle);
-        pointLight.position = glm::vec3(5.0f, 10.0f, -5.0f);
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-
-        ourShader.setFloat("material.shininessBP", 32.0f);
-        ourShader.setFloat("material.shininess", 8.0f);
-        ourShader.setInt("blinn", blinn);
-
-        ourShader.setVec3("dirLight.direction", dirLight.direction);
-        ourShader.setVec3("dirLight.ambient", dirLight.ambient);
-        ourShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        ourShader.setVec3("dirLight.specular", dirLight.specular);
-
-
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-
-        // castle
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 2.0f, 0.0f));         // koordinate (x, y, z): y - vertikalna osa
-        model = glm::scale(model, glm::vec3(0.3f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(-1.0, 0.0, 0.0));
-        ourShader.setMat4("model", model);
-        castleModel.Draw(ourShader);
-
-        // TODO fix dobby
-        // dobby
+        BlurKernel blurKernel = BloomBlurKernel(bloomRadius);
+        shaderBlur.use();
+        SetBlurKernel(shaderBlur, blurKernel);
+        if (shaderComputeBlur) {
+            shaderComputeBlur->use();
+            SetBlurKernel(*shaderComputeBlur, blurKernel);
+        }
+
+        shaderBloomFinal.use();
+        shaderBloomFinal.setInt("scene", 0);
+        shaderBloomFinal.setInt("bloomBlur", 1);
+
+        normalShader.use();
+        normalShader.setInt("diffuseMap", 0);
+        normalShader.setInt("normalMap", 1);
+        normalShader.setInt("depthMap", 2);
+
+        // lighting info
+        glm::vec3 lightPos(-2.0f, 3.0f, -9.3f);
+
+        // uniforms the render loop sets every frame, resolved once up front
+        UniformLocation ourMaterialShininessBP = ourShader.uniform("material.shininessBP");
+        UniformLocation ourMaterialShininess = ourShader.uniform("material.shininess");
+        UniformLocation ourBlinn = ourShader.uniform("blinn");
+        UniformLocation ourModel = ourShader.uniform("model");
+
+        UniformLocation lightBoxModel = shaderLight.uniform("model");
+        UniformLocation lightBoxColor = shaderLight.uniform("lightColor");
+
+        UniformLocation normalModel = normalShader.uniform("model");
+        UniformLocation normalHeightScale = normalShader.uniform("heightScale");
+        UniformLocation normalGamma = normalShader.uniform("gamma");
+
+        UniformLocation bloomFinalHdr = shaderBloomFinal.uniform("hdr");
+        UniformLocation bloomFinalBloom = shaderBloomFinal.uniform("bloom");
+        UniformLocation bloomFinalGamma = shaderBloomFinal.uniform("gamma");
+        UniformLocation bloomFinalExposure = shaderBloomFinal.uniform("exposure");
+        UniformLocation bloomFinalIntensity = shaderBloomFinal.uniform("bloomIntensity");
+
+        // render loop
+        while (!glfwWindowShouldClose(window)) {
+            // per-frame time logic
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+            float yCircle = cos(currentFrame);
+            float zCircle = sin(currentFrame);
+
+            // input
+            processInput(window);
+
+            // upload the next part of the models that are still streaming in
+            if (!sceneLoaded) {
+                modelStreamer.Update();
+                sceneLoaded = modelStreamer.Done();
+                if (sceneLoaded) {
+                    // startup timing report, run twice to compare a cold start (no mesh cache yet) with a warm one
+                    unsigned int cachedModels = 0;
+                    double meshLoadTime = 0.0, textureLoadTime = 0.0;
+                    for (Model *sceneModel : sceneModels) {
+                        cachedModels += sceneModel->loadedFromCache;
+                        meshLoadTime += sceneModel->meshLoadMilliseconds;
+                        textureLoadTime += sceneModel->textureLoadMilliseconds;
+                    }
+                    std::cout << "Scene models loaded in " << (glfwGetTime() - modelLoadStart) * 1000.0 << " ms ("
+                              << cachedModels << "/" << sizeof(sceneModels) / sizeof(sceneModels[0]) << " from mesh cache, meshes "
+                              << meshLoadTime << " ms, textures " << textureLoadTime << " ms)" << std::endl;
+
+                    auto addModel = [&](const Model &sceneModel, const glm::mat4 &matrix, bool dynamic) {
+                        glm::vec3 boxMin, boxMax;
+                        TransformBox(sceneModel.boundsMin, sceneModel.boundsMax, matrix, boxMin, boxMax);
+                        return sceneBvh.Add(boxMin, boxMax, dynamic);
+                    };
+                    sceneObjects.castle = addModel(castleModel, castleMatrix, false);
+                    sceneObjects.rock = addModel(rockModel, rockMatrix, false);
+                    sceneObjects.quidditch = addModel(quidditchModel, quidditchMatrix, false);
+                    sceneObjects.griffin = addModel(griffinModel, griffinMatrix, false);
+                    for (const glm::mat4 &matrix : treeInstances)
+                        sceneObjects.trees.push_back(addModel(treeModel, matrix, false));
+                    for (const glm::mat4 &matrix : mapleTreeInstances)
+                        sceneObjects.mapleTrees.push_back(addModel(mapleTreeModel, matrix, false));
+                    // the animated ones get their real boxes every frame
+                    sceneObjects.snitch = sceneBvh.Add(glm::vec3(0.0f), glm::vec3(0.0f), true);
+                    sceneObjects.phoenix = sceneBvh.Add(glm::vec3(0.0f), glm::vec3(0.0f), true);
+                    sceneObjects.nimbus = sceneBvh.Add(glm::vec3(0.0f), glm::vec3(0.0f), true);
+                    for (unsigned int i = 0; i < lightPositions.size(); i++)
+                        sceneObjects.lightCubes.push_back(sceneBvh.Add(glm::vec3(0.0f), glm::vec3(0.0f), true));
+                    sceneBvh.Build();
+                }
+            }
+
+            // resolution of the scene's targets for this frame. the targets are recreated when it changes, the window's
+            // (resized or minimized) or the scale's.
+            int windowWidth, windowHeight;
+            glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+            windowWidth = std::max(windowWidth, 1);
+            windowHeight = std::max(windowHeight, 1);
+            float resolutionScale = dynamicResolution ? resolutionController.Scale() : 1.0f;
+            unsigned int frameWidth = std::max(1, (int) std::round(windowWidth * resolutionScale));
+            unsigned int frameHeight = std::max(1, (int) std::round(windowHeight * resolutionScale));
+            if (frameWidth != renderWidth || frameHeight != renderHeight) {
+                renderWidth = frameWidth;
+                renderHeight = frameHeight;
+                renderTargets.Clear();
+                bloomMipChain.Resize(renderWidth, renderHeight);
+                if (computeBlur)
+                    computeBlur->Resize(renderWidth, renderHeight);
+            }
+
+            // render
+            glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+
+            //pointLight.position = glm::vec3(4.0 * yCircle, 4.0f, 4.0 * zCircle);
+            pointLight.position = glm::vec3(5.0f, 10.0f, -5.0f);
+
+            // camera and lights of all scene shaders, uploaded once for the frame
+            FrameDataBlock &frame = frameUniforms.frame;
+            frame.view = programState->camera.GetViewMatrix();
+            frame.projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)windowWidth / (float)windowHeight, 0.1f, 100.0f);
+            frame.cameraPosition = programState->camera.Position;
+            frame.time = currentFrame;
+            LightsBlock &lights = frameUniforms.lights;
+            lights.pointLight.position = pointLight.position;
+            lights.pointLight.ambient = pointLight.ambient;
+            lights.pointLight.diffuse = pointLight.diffuse;
+            lights.pointLight.specular = pointLight.specular;
+            lights.pointLight.constant = pointLight.constant;
+            lights.pointLight.linear = pointLight.linear;
+            lights.pointLight.quadratic = pointLight.quadratic;
+            lights.dirLight.direction = dirLight.direction;
+            lights.dirLight.ambient = dirLight.ambient;
+            lights.dirLight.diffuse = dirLight.diffuse;
+            lights.dirLight.specular = dirLight.specular;
+            for (unsigned int i = 0; i < lightPositions.size() && i < MAX_LAMPS; i++) {
+                lights.lamps[i].position = lightPositions[i];
+                lights.lamps[i].color = lightColors[i];
+            }
+            lights.floorLightPosition = lightPos;
+            frameUniforms.Update();
+            SetLodView(programState->camera.Position, glm::radians(programState->camera.Zoom), (float)renderHeight, LOD_PIXEL_ERROR);
+            if (FRUSTUM_CULLING)
+                SetCullingView(frame.projection * frame.view);
+
+            // animated objects
+            glm::mat4 snitchMatrix = glm::mat4(1.0f);
+            snitchMatrix = glm::translate(snitchMatrix, glm::vec3(0.0f + 5*yCircle*zCircle, -8.0f + yCircle, -9.5f + 5*zCircle*yCircle));
+            snitchMatrix = glm::scale(snitchMatrix, glm::vec3(0.09f));
+
+            glm::mat4 phoenixMatrix = glm::mat4(1.0f);
+            phoenixMatrix = glm::translate(phoenixMatrix, glm::vec3(0.0f - 3*yCircle, 5.0f, 8.0f - 2*zCircle));
+            phoenixMatrix = glm::rotate(phoenixMatrix, glm::radians(17.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
+            phoenixMatrix = glm::rotate(phoenixMatrix, glm::radians(53.3f*currentFrame), glm::vec3(0.0f, -1.0f, 0.0f));
+            phoenixMatrix = glm::scale(phoenixMatrix, glm::vec3(0.0005f));
+
+            glm::mat4 nimbusMatrix = glm::mat4(1.0f);
+            nimbusMatrix = glm::translate(nimbusMatrix, glm::vec3(-4.0f, -8.0f + yCircle, -9.5f));
+            nimbusMatrix = glm::scale(nimbusMatrix, glm::vec3(0.25f));
+
+            glm::vec3 lightCubeOffset(yCircle, 0.0f, zCircle);
+            const float lightCubeSize = 0.18f;
+
+            // move the animated objects in the scene BVH and cull all objects against the view frustum with it
+            if (sceneBvh.Built()) {
+                auto updateModel = [&](unsigned int handle, const Model &sceneModel, const glm::mat4 &matrix) {
+                    glm::vec3 boxMin, boxMax;
+                    TransformBox(sceneModel.boundsMin, sceneModel.boundsMax, matrix, boxMin, boxMax);
+                    sceneBvh.Update(handle, boxMin, boxMax);
+                };
+                updateModel(sceneObjects.snitch, goldenSnitchModel, snitchMatrix);
+                updateModel(sceneObjects.phoenix, phoenixModel, phoenixMatrix);
+                updateModel(sceneObjects.nimbus, nimbusModel, nimbusMatrix);
+                for (unsigned int i = 0; i < lightPositions.size(); i++) {
+                    glm::vec3 position = lightPositions[i] + lightCubeOffset;
+                    sceneBvh.Update(sceneObjects.lightCubes[i], position - glm::vec3(lightCubeSize), position + glm::vec3(lightCubeSize));
+                }
+                sceneBvh.Refit();
+                if (FRUSTUM_CULLING)
+                    sceneBvh.CullFrustum(FrustumFromMatrix(frame.projection * frame.view), objectVisible);
+            }
+            occlusionCuller.BeginFrame();
+            if (cullingBenchmarkRequested) {
+                cullingBenchmarkRequested = false;
+                benchmarkCulling(frame.projection * frame.view);
+            }
+            auto visible = [&](unsigned int handle) {
+                if (!sceneBvh.Built())
+                    return true;
+                if (FRUSTUM_CULLING && !objectVisible[handle])
+                    return false;
+                if (occlusionCulling && !occlusionCuller.Visible(handle)) {
+                    FrameStats().objectsOccluded++;
+                    return false;
+                }
+                return true;
+            };
+            auto visibleInstances = [&](const std::vector<glm::mat4> &instances, const std::vector<unsigned int> &handles,
+                                        std::vector<glm::mat4> &out) {
+                out.clear();
+                for (unsigned int i = 0; i < instances.size(); i++)
+                    if (i >= handles.size() || visible(handles[i]))
+                        out.push_back(instances[i]);
+            };
+
+            // the scene is queued draw by draw and drawn sorted by state and depth, see render_queue.h
+            renderQueue.Begin(programState->camera.Position, 100.0f);
+
+            ourShader.use();
+            ourShader.setFloat(ourMaterialShininessBP, 32.0f);
+            ourShader.setFloat(ourMaterialShininess, 8.0f);
+            ourShader.setInt(ourBlinn, blinn);
+
+            // castle
+            if (visible(sceneObjects.castle))
+                castleModel.Submit(renderQueue, LAYER_OPAQUE, ourShader, ourModel, castleMatrix);
+
+            // TODO fix dobby
+            // dobby
 //        model = glm::mat4(1.0f);
 //        model = glm::translate(model, glm::vec3(-9.0f, 4.0f, -1.8f));
 //        model = glm::scale(model, glm::vec3(0.007f));
@@ -494,84 +764,35 @@ int main() {
 //        ourShader.setMat4("model", model);
 //        dobbyModel.Draw(ourShader);
 
-        // rock
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-16.0f, 55.25f, -11.0f));
-        model = glm::translate(model, glm::vec3(0.0f));
-        model = glm::scale(model, glm::vec3(0.37f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        rockModel.Draw(ourShader);
-
-        // quidditch
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-1.5f, -10.0f, -6.0f));
-        model = glm::translate(model, glm::vec3(0.0f));
-        model = glm::scale(model, glm::vec3(0.068f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        quidditchModel.Draw(ourShader);
-
-        // golden snitch
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f + 5*yCircle*zCircle, -8.0f + yCircle, -9.5f + 5*zCircle*yCircle));
-        model = glm::scale(model, glm::vec3(0.09f));
-        ourShader.setMat4("model", model);
-        goldenSnitchModel.Draw(ourShader);
-
-        // griffin
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(5.0f, 2.2f, 5.5f));
-        model = glm::scale(model, glm::vec3(0.05f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        griffinModel.Draw(ourShader);
-
-        // phoenix
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f - 3*yCircle, 5.0f, 8.0f - 2*zCircle));
-        model = glm::rotate(model, glm::radians(17.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(53.3f*currentFrame), glm::vec3(0.0f, -1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.0005f));
-        ourShader.setMat4("model", model);
-        phoenixModel.Draw(ourShader);
-
-        // first maple tree
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-6.0f, 2.0f, -5.6f));
-        model = glm::scale(model, glm::vec3(0.05f));
-        ourShader.setMat4("model", model);
-        mapleTreeModel.Draw(ourShader);
-
-        // second maple tree
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-2.0f, 2.0f, -7.3f));
-        model = glm::scale(model, glm::vec3(0.05f));
-        ourShader.setMat4("model", model);
-        mapleTreeModel.Draw(ourShader);
-
-        // third maple tree
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 2.0f, -7.2f));
-        model = glm::scale(model, glm::vec3(0.05f));
-        ourShader.setMat4("model", model);
-        mapleTreeModel.Draw(ourShader);
-
-        // fourth maple tree
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(6.0f, 2.0f, -5.0f));
-        model = glm::scale(model, glm::vec3(0.05f));
-        ourShader.setMat4("model", model);
-        mapleTreeModel.Draw(ourShader);
+            // rock
+            if (visible(sceneObjects.rock))
+                rockModel.Submit(renderQueue, LAYER_OPAQUE, ourShader, ourModel, rockMatrix);
 
-        // nimbus
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-4.0f, -8.0f + yCircle, -9.5f));
-        model = glm::scale(model, glm::vec3(0.25f));
-        ourShader.setMat4("model", model);
-        nimbusModel.Draw(ourShader);
+            // quidditch
+            if (visible(sceneObjects.quidditch))
+                quidditchModel.Submit(renderQueue, LAYER_OPAQUE, ourShader, ourModel, quidditchMatrix);
+
+            // golden snitch
+            if (visible(sceneObjects.snitch))
+                goldenSnitchModel.Submit(renderQueue, LAYER_OPAQUE, ourShader, ourModel, snitchMatrix);
 
-        // logo
+            // griffin
+            if (visible(sceneObjects.griffin))
+                griffinModel.Submit(renderQueue, LAYER_OPAQUE, ourShader, ourModel, griffinMatrix);
+
+            // phoenix
+            if (visible(sceneObjects.phoenix))
+                phoenixModel.Submit(renderQueue, LAYER_OPAQUE, ourShader, ourModel, phoenixMatrix);
+
+            // maple trees, their leaves are cut out of the textures by alpha
+            visibleInstances(mapleTreeInstances, sceneObjects.mapleTrees, visibleMapleTrees);
+            mapleTreeModel.SubmitInstanced(renderQueue, LAYER_ALPHA_TESTED, ourShader, ourModel, visibleMapleTrees);
+
+            // nimbus
+            if (visible(sceneObjects.nimbus))
+                nimbusModel.Submit(renderQueue, LAYER_OPAQUE, ourShader, ourModel, nimbusMatrix);
+
+            // logo
 //        model = glm::mat4(1.0f);
 //        model = glm::translate(model, glm::vec3(5.0f, 10.0f, -5.0f));
 //        model = glm::scale(model, glm::vec3(4.0f));
@@ -580,77 +801,50 @@ int main() {
 //        logoModel.Draw(ourShader);
 
 
-        // trees
-        for(unsigned int i = 0; i < treePositions.size(); ++i) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(treePositions[i]));
-            model = glm::scale(model, glm::vec3(0.13f));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
-            ourShader.setMat4("model", model);
-            treeModel.Draw(ourShader);
-        }
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-9.0f, -3.52f, -3.8f));
-        model = glm::scale(model, glm::vec3(0.13f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
-        ourShader.setMat4("model", model);
-        treeModel.Draw(ourShader);
+            // trees
+            visibleInstances(treeInstances, sceneObjects.trees, visibleTrees);
+            treeModel.SubmitInstanced(renderQueue, LAYER_ALPHA_TESTED, ourShader, ourModel, visibleTrees);
 
 
 //        if (programState->ImGuiEnabled)
 //            DrawImGui(programState);
 
-        projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        view = programState->camera.GetViewMatrix();
-        shader.use();
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
-
-        // set lighting uniforms
-        for (unsigned int i = 0; i < lightPositions.size(); i++) {
-            shader.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-            shader.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-        }
-        shader.setVec3("viewPos", programState->camera.Position);
-
-        // light sources as white cubes
-        shaderLight.use();
-        shaderLight.setMat4("projection", projection);
-        shaderLight.setMat4("view", view);
-
-        for (unsigned int i = 0; i < lightPositions.size(); i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(lightPositions[i]) + glm::vec3(yCircle, 0.0f, zCircle));
-            model = glm::scale(model, glm::vec3(0.18f));
-            shaderLight.setMat4("model", model);
-            shaderLight.setVec3("lightColor", lightColors[i]);
-            renderCube();
-        }
-
-        glDisable(GL_CULL_FACE);
-
-        // configure view/projection matrices for floor
-        projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        view = programState->camera.GetViewMatrix();
-        normalShader.use();
-        normalShader.setMat4("projection", projection);
-        normalShader.setMat4("view", view);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-9.0f, -3.52f, -1.8f));
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f)); // rotate the quad to show normal mapping from multiple directions
-        model = glm::scale(model, glm::vec3(3.2f));
-        normalShader.setMat4("model", model);
-        normalShader.setVec3("viewPos", programState->camera.Position);
-        normalShader.setVec3("lightPos", lightPos);
-        normalShader.setFloat("heightScale", heightScale);
-        normalShader.setInt("gamma", gammaOn);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gammaOn ? diffuseMapGamma : diffuseMap);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, normalMap);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, heightMap);
-        renderFloor();
+            // light sources as white cubes
+            for (unsigned int i = 0; i < lightPositions.size(); i++) {
+                if (i < sceneObjects.lightCubes.size() && !visible(sceneObjects.lightCubes[i]))
+                    continue;
+                glm::vec3 position = lightPositions[i] + lightCubeOffset;
+                glm::vec3 color = lightColors[i];
+                renderQueue.SubmitCustom(LAYER_OPAQUE, shaderLight, position, [&, position, color]() {
+                    glm::mat4 model = glm::mat4(1.0f);
+                    model = glm::translate(model, position);
+                    model = glm::scale(model, glm::vec3(lightCubeSize));
+                    shaderLight.setMat4(lightBoxModel, model);
+                    shaderLight.setVec3(lightBoxColor, color);
+                    renderCube();
+                });
+            }
+
+            // floor, its parallax mapping discards fragments that leave the texture
+            glm::vec3 floorPosition(-9.0f, -3.52f, -1.8f);
+            renderQueue.SubmitCustom(LAYER_ALPHA_TESTED, normalShader, floorPosition, [&]() {
+                glDisable(GL_CULL_FACE);
+                glm::mat4 model = glm::mat4(1.0f);
+                model = glm::translate(model, floorPosition);
+                model = glm::rotate(model, glm::radians(90.0f), glm::vec3(-1.0f, 0.0f, 0.0f)); // rotate the quad to show normal mapping from multiple directions
+                model = glm::scale(model, glm::vec3(3.2f));
+                normalShader.setMat4(normalModel, model);
+                normalShader.setFloat(normalHeightScale, heightScale);
+                normalShader.setInt(normalGamma, gammaOn);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, gammaOn ? diffuseMapGamma : diffuseMap);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, normalMap);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D, heightMap);
+                renderFloor();
+                glEnable(GL_CULL_FACE);
+            });
 
 //        // render light source (simply re-renders a smaller plane at the light's position for debugging/visualization)
 //        model = glm::mat4(1.0f);
@@ -659,65 +853,225 @@ int main() {
 //        normalShader.setMat4("model", model);
 //        renderFloor();
 
-        glEnable(GL_CULL_FACE);
-
-        // lastly, render skybox
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
-
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // 2. blur bright fragments with two-pass Gaussian Blur
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        shaderBlur.use();
-        for (unsigned int i = 0; i < amount; i++)
-        {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            shaderBlur.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+            // skybox, behind everything else
+            renderQueue.SubmitCustom(LAYER_SKY, skyboxShader, programState->camera.Position, [&]() {
+                glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+                glBindVertexArray(skyboxVAO);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                glBindVertexArray(0);
+                glDepthFunc(GL_LESS); // set depth function back to default
+            });
+
+            if (blurKernel.radius != bloomRadius) {
+                blurKernel = BloomBlurKernel(bloomRadius);
+                shaderBlur.use();
+                SetBlurKernel(shaderBlur, blurKernel);
+                if (shaderComputeBlur) {
+                    shaderComputeBlur->use();
+                    SetBlurKernel(*shaderComputeBlur, blurKernel);
+                }
+            }
+            if (bloomBlur == BLOOM_COMPUTE && !computeBlur)
+                bloomBlur = BLOOM_MIP_CHAIN;
+
+            // the frame's passes, see frame_graph.h. the bloom blur is culled when bloom is off, and the scene pass then
+            // leaves out the bright colors.
+            FrameGraph graph(renderTargets);
+            RenderTargetDesc screenColor;
+            screenColor.width = renderWidth;
+            screenColor.height = renderHeight;
+            screenColor.internalFormat = GL_RGBA16F;
+            RenderTargetDesc screenDepth = screenColor;
+            screenDepth.internalFormat = GL_DEPTH_COMPONENT24;
+            unsigned int sceneColor = graph.CreateTexture("scene color", screenColor);
+            unsigned int brightColor = graph.CreateTexture("bright color", screenColor);
+            unsigned int sceneDepth = graph.CreateTexture("scene depth", screenDepth);
+
+            // 1. the queued scene into the floating point targets (FragColor and BrightColor)
+            graph.AddPass("scene", {}, {sceneColor, brightColor, sceneDepth}, [&]() {
+                graph.BindFramebuffer({sceneColor, brightColor}, sceneDepth);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                renderQueue.Execute();
+
+                // occlusion queries of the object boxes against this frame's depth buffer, the next frames draw by their results
+                if (occlusionCulling && sceneBvh.Built()) {
+                    occlusionCuller.BeginQueries(programState->camera.Position);
+                    for (unsigned int handle = 0; handle < sceneBvh.Size(); handle++) {
+                        if (FRUSTUM_CULLING && !objectVisible[handle])
+                            continue;
+                        glm::vec3 boxMin, boxMax;
+                        sceneBvh.ObjectBox(handle, boxMin, boxMax);
+                        occlusionCuller.Query(handle, boxMin, boxMax);
+                    }
+                    occlusionCuller.EndQueries();
+                }
+            });
+
+            bool benchmarkFrame = blurBenchmarkRequested;
+            if (blurBenchmarkRequested) {
+                blurBenchmarkRequested = false;
+                graph.AddPass("blur benchmark", {brightColor}, {}, [&]() {
+                    benchmarkBlur(graph.Texture(brightColor), renderWidth, renderHeight, shaderBlur, shaderComputeBlur.get());
+                }, true);
+            }
+
+            // 2. blur bright fragments, down and up the mip chain or with the two-pass Gaussian blur at full resolution (in
+            // the fragment or the compute shader)
+            unsigned int bloomColor;
+            float bloomIntensity = BLOOM_INTENSITY;
+            if (bloomBlur == BLOOM_PING_PONG) {
+                // a pass per direction and iteration, each into a new target: the graph gets by with two textures for all
+                // of them and the bright colors
+                unsigned int input = brightColor;
+                for (unsigned int i = 0; i < 2 * BLOOM_BLUR_ITERATIONS; i++) {
+                    bool horizontal = i % 2 == 0;
+                    bool first = i == 0, last = i + 1 == 2 * BLOOM_BLUR_ITERATIONS;
+                    unsigned int output = graph.CreateTexture(horizontal ? "horizontal blur" : "vertical blur", screenColor);
+                    graph.AddPass("ping-pong blur", {input}, {output}, [&, input, output, horizontal, first, last]() {
+                        if (first)
+                            bloomTimers[BLOOM_PING_PONG].Begin();
+                        graph.BindFramebuffer({output});
+                        pingPongBlur.Pass(graph.Texture(input), horizontal, renderQuad);
+                        if (last)
+                            bloomTimers[BLOOM_PING_PONG].End();
+                    });
+                    input = output;
+                }
+                bloomColor = input;
+            }
+            else {
+                // the mip chain and the compute blur keep their own targets
+                bloomColor = graph.ImportTexture("bloom");
+                if (bloomBlur == BLOOM_MIP_CHAIN)
+                    bloomIntensity /= bloomMipChain.Levels();  // the levels add up, see BloomMipChain
+                graph.AddPass(BLOOM_BLUR_NAMES[bloomBlur], {brightColor}, {bloomColor}, [&]() {
+                    bloomTimers[bloomBlur].Begin();
+                    unsigned int texture;
+                    if (bloomBlur == BLOOM_MIP_CHAIN)
+                        texture = bloomMipChain.Render(graph.Texture(brightColor), BLOOM_RADIUS * bloomRadius / BLOOM_BLUR_RADIUS, renderQuad);
+                    else
+                        texture = computeBlur->Render(graph.Texture(brightColor), BLOOM_BLUR_ITERATIONS);
+                    bloomTimers[bloomBlur].End();
+                    graph.SetImportedTexture(bloomColor, texture);
+                });
+            }
+
+            // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range,
+            // scaling the scene up to the window with the targets' linear filtering
+            std::vector<unsigned int> compositeInputs = {sceneColor};
+            if (bloom)
+                compositeInputs.push_back(bloomColor);
+            graph.AddPass("composite", compositeInputs, {}, [&]() {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glViewport(0, 0, windowWidth, windowHeight);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                shaderBloomFinal.use();
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, graph.Texture(sceneColor));
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, bloom ? graph.Texture(bloomColor) : 0);
+                shaderBloomFinal.setInt(bloomFinalHdr, hdr);
+                shaderBloomFinal.setInt(bloomFinalBloom, bloom);
+                shaderBloomFinal.setInt(bloomFinalGamma, gammaOn);
+                shaderBloomFinal.setFloat(bloomFinalExposure, exposure);
+                shaderBloomFinal.setFloat(bloomFinalIntensity, bloomIntensity);
+                renderQuad();
+            }, true);
+
+            graph.Compile();
+            std::string graphDescription = graph.Describe();
+            if (graphDescription != lastFrameGraph) {
+                lastFrameGraph = graphDescription;
+                std::cout << "Frame graph:\n" << graphDescription << std::flush;
+            }
+            // a frame with the blur benchmark takes hundreds of milliseconds and isn't timed, the controller would drop
+            // the resolution to the minimum for it
+            if (!benchmarkFrame)
+                frameTimer.Begin();
+            graph.Execute();
+            if (!benchmarkFrame)
+                frameTimer.End();
+            renderTargets.EndFrame();
+
+            // the timer results lag a few frames behind, the controller averages them
+            double gpuMilliseconds = frameTimer.TakeAverage();
+            if (gpuMilliseconds > 0.0) {
+                frameMilliseconds = gpuMilliseconds;
+                if (dynamicResolution)
+                    resolutionController.Update(gpuMilliseconds);
+            }
+
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+
+            if (!firstFramePresented) {
+                firstFramePresented = true;
+                std::cout << "First frame presented " << (glfwGetTime() - modelLoadStart) * 1000.0 << " ms after model loading started" << std::endl;
+            }
+
+            // triangle, culling and state change readout in the window title, to see what the model LODs, frustum and
+            // occlusion culling and the render queue save, the GPU time of the frame with the resolution it ran at, and of
+            // the bloom blurs (the last one measured for the blurs that are switched off)
+            if (currentFrame - lastStatsUpdate >= 0.5f) {
+                lastStatsUpdate = currentFrame;
+                const RenderStats &stats = FrameStats();
+                for (unsigned int i = 0; i < BLOOM_BLUR_COUNT; i++)
+                {
+                    double milliseconds = bloomTimers[i].TakeAverage();
+                    if (milliseconds > 0.0)
+                        bloomMilliseconds[i] = milliseconds;
+                }
+                std::string title = "computer graphics project | " + std::to_string(stats.triangles) + " triangles (LOD 0: "
+                                    + std::to_string(stats.fullDetailTriangles) + "), " + std::to_string(stats.meshesVisible) + "/"
+                                    + std::to_string(stats.meshesVisible + stats.meshesCulled) + " meshes visible, "
+                                    + std::to_string(stats.drawCalls) + " draws (" + std::to_string(stats.multiDrawCommands)
+                                    + " meshes in multi-draws), "
+                                    + std::to_string(stats.programChanges) + " programs, " + std::to_string(stats.textureBinds)
+                                    + " texture binds, " + std::to_string(stats.objectsOccluded) + " occluded ("
+                                    + std::to_string(stats.occlusionQueries) + " queries), " + std::to_string(stats.passes)
+                                    + " passes (" + std::to_string(stats.passesCulled) + " culled), "
+                                    + std::to_string(renderTargets.TextureCount()) + " render targets ("
+                                    + std::to_string(renderTargets.Bytes() / (1024 * 1024)) + " MB)";
+                char frameTime[80];
+                snprintf(frameTime, sizeof(frameTime), ", %ux%u (%d%%) in %.2f ms GPU", renderWidth, renderHeight,
+                         (int) std::round(100.0f * renderWidth / windowWidth), frameMilliseconds);
+                title += frameTime;
+                title += ", bloom";
+                for (unsigned int i = 0; i < BLOOM_BLUR_COUNT; i++)
+                {
+                    if (i == BLOOM_COMPUTE && !computeBlur)
+                        continue;
+                    char bloomTime[48];
+                    snprintf(bloomTime, sizeof(bloomTime), "%s %.3f ms %s", i == 0 ? "" : " /", bloomMilliseconds[i],
+                             BLOOM_BLUR_NAMES[i]);
+                    title += bloomTime;
+                }
+                glfwSetWindowTitle(window, title.c_str());
+            }
+            ResetFrameStats();
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        shaderBloomFinal.use();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        shaderBloomFinal.setInt("hdr", hdr);
-        shaderBloomFinal.setInt("bloom", bloom);
-        shaderBloomFinal.setInt("gamma", gammaOn);
-        shaderBloomFinal.setFloat("exposure", exposure);
-        renderQuad();
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
 
-    programState->SaveToFile("resources/program_state.txt");
-    delete programState;
+        programState->SaveToFile("resources/program_state.txt");
+        delete programState;
 //    ImGui_ImplOpenGL3_Shutdown();
 //    ImGui_ImplGlfw_Shutdown();
 //    ImGui::DestroyContext();
 
-    glDeleteVertexArrays(1, &skyboxVAO);
-    glDeleteBuffers(1, &skyboxVBO);
+        glDeleteVertexArrays(1, &skyboxVAO);
+        glDeleteBuffers(1, &skyboxVBO);
+        renderTargets.Clear();
+
+        TextureCache::Instance().Release(diffuseMap);
+        TextureCache::Instance().Release(diffuseMapGamma);
+        TextureCache::Instance().Release(normalMap);
+        TextureCache::Instance().Release(heightMap);
+    }
+
+    // textures nobody released anymore, Shutdown deletes them
+    TextureCache::Instance().Shutdown();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     glfwTerminate();
@@ -778,6 +1132,57 @@ void processInput(GLFWwindow *window) {
         gammaKeyPressed = false;
     }
 
+    // occlusion culling activation
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !occlusionKeyPressed) {
+        occlusionCulling = !occlusionCulling;
+        occlusionKeyPressed = true;
+        std::cout << "Occlusion culling " << (occlusionCulling ? "on" : "off") << std::endl;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE) {
+        occlusionKeyPressed = false;
+    }
+
+    // dynamic resolution activation
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !dynamicResolutionKeyPressed) {
+        dynamicResolution = !dynamicResolution;
+        dynamicResolutionKeyPressed = true;
+        std::cout << "Dynamic resolution " << (dynamicResolution ? "on" : "off") << std::endl;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE) {
+        dynamicResolutionKeyPressed = false;
+    }
+
+    // bloom blur: ping-pong, mip chain or compute
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !bloomBlurKeyPressed) {
+        bloomBlur = (BloomBlur) ((bloomBlur + 1) % BLOOM_BLUR_COUNT);
+        if (bloomBlur == BLOOM_COMPUTE && !ComputeBlurSupported())
+            bloomBlur = BLOOM_PING_PONG;
+        bloomBlurKeyPressed = true;
+        std::cout << "Bloom blur: " << BLOOM_BLUR_NAMES[bloomBlur] << std::endl;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE) {
+        bloomBlurKeyPressed = false;
+    }
+
+    // bloom radius
+    bool smallerBloom = glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS;
+    bool largerBloom = glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS;
+    if ((smallerBloom || largerBloom) && !bloomRadiusKeyPressed) {
+        if (smallerBloom && bloomRadius > 1)
+            bloomRadius--;
+        if (largerBloom && bloomRadius < BLUR_MAX_RADIUS)
+            bloomRadius++;
+        bloomRadiusKeyPressed = true;
+        std::cout << "Bloom radius " << bloomRadius << " texels" << std::endl;
+    }
+
+    if (!smallerBloom && !largerBloom) {
+        bloomRadiusKeyPressed = false;
+    }
+
     // exposure
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
         if (exposure > 0.0f) {
@@ -793,7 +1198,8 @@ void processInput(GLFWwindow *window) {
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
-    // height will be significantly larger than specified on retina displays.
+    // height will be significantly larger than specified on retina displays. the render targets follow on the next
+    // frame.
     glViewport(0, 0, width, height);
 }
 
@@ -865,6 +1271,10 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
         }
     }
+    if (key == GLFW_KEY_C && action == GLFW_PRESS)
+        cullingBenchmarkRequested = true;
+    if (key == GLFW_KEY_X && action == GLFW_PRESS)
+        blurBenchmarkRequested = true;
 }
 
 // loads a cubemap texture from 6 individual texture faces
@@ -1097,78 +1507,133 @@ void renderFloor() {
     glBindVertexArray(0);
 }
 
+// loads a texture through the shared texture cache, so files that are also used elsewhere are only uploaded once.
+// the returned texture holds a reference that is given back with TextureCache::Release.
 unsigned int loadTexture(char const * path, bool gammaCorrection) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    return TextureCache::Instance().Load(path, gammaCorrection ? COLORSPACE_SRGB : COLORSPACE_LINEAR, WRAP_REPEAT);
+}
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
-        {
-            internalFormat = dataFormat = GL_RED;
-        }
-        else if (nrComponents == 3)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
+// for this tutorial: textures with an alpha channel use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
+unsigned int loadTexture(char const * path, Texture_Usage usage) {
+    return TextureCache::Instance().Load(path, COLORSPACE_LINEAR, WRAP_CLAMP_IF_ALPHA, usage);
+}
+
+// compares culling random boxes with the flat CullBoxes batch test and with the scene BVH for the given view, and
+// prints the timings to the console. a tenth of the boxes are dynamic and moved for the refit timing.
+void benchmarkCulling(const glm::mat4 &viewProjection)
+{
+    typedef std::chrono::steady_clock Clock;
+    auto milliseconds = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    const int REPETITIONS = 20;
+    Frustum frustum = FrustumFromMatrix(viewProjection);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f), size(0.2f, 4.0f);
+
+    for (unsigned int count : {10000u, 100000u}) {
+        BoxBatch batch;
+        SceneBVH bvh;
+        for (unsigned int i = 0; i < count; i++) {
+            glm::vec3 boxMin(position(random), position(random) * 0.1f, position(random));
+            glm::vec3 boxMax = boxMin + glm::vec3(size(random), size(random), size(random));
+            batch.Add(boxMin, boxMax);
+            bvh.Add(boxMin, boxMax, i % 10 == 0);
         }
-        else if (nrComponents == 4)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
+        Clock::time_point start = Clock::now();
+        bvh.Build();
+        double buildTime = milliseconds(start);
+
+        std::vector<unsigned char> flatVisible(count), bvhVisible;
+        size_t visibleCount = 0;
+        start = Clock::now();
+        for (int i = 0; i < REPETITIONS; i++)
+            visibleCount = CullBoxes(frustum, batch, flatVisible.data());
+        double flatTime = milliseconds(start) / REPETITIONS;
+        start = Clock::now();
+        for (int i = 0; i < REPETITIONS; i++)
+            bvh.CullFrustum(frustum, bvhVisible);
+        double bvhTime = milliseconds(start) / REPETITIONS;
+
+        for (unsigned int i = 0; i < count; i += 10) {
+            glm::vec3 offset(0.5f, 0.0f, 0.5f);
+            bvh.Update(i, glm::vec3(batch.centerX[i], batch.centerY[i], batch.centerZ[i]) - offset,
+                       glm::vec3(batch.centerX[i], batch.centerY[i], batch.centerZ[i]) + offset);
         }
+        start = Clock::now();
+        bvh.Refit();
+        double refitTime = milliseconds(start);
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        std::cout << "Culling " << count << " boxes (" << visibleCount << " visible): flat " << flatTime << " ms, BVH "
+                  << bvhTime << " ms (" << bvh.NodeCount() << " nodes, build " << buildTime << " ms, refit "
+                  << refitTime << " ms)" << std::endl;
     }
-
-    return textureID;
 }
 
+// GPU time of the fragment and the compute shader Gaussian blur at 1080p and 4K, on the current frame's bright pass
+// scaled up. every run is waited for, so the timer queries come back before the next one starts.
+void benchmarkBlur(unsigned int brightTexture, unsigned int brightWidth, unsigned int brightHeight, Shader &blurShader,
+                   Shader *computeBlurShader)
+{
+    const int REPETITIONS = 20;
+    GpuTimer timer;
+    auto gpuMilliseconds = [&timer](const std::function<void()> &blur) {
+        // one run to warm up
+        blur();
+        glFinish();
+        timer.TakeAverage();
+        for (int i = 0; i < REPETITIONS; i++) {
+            timer.Begin();
+            blur();
+            timer.End();
+            glFinish();
+        }
+        return timer.TakeAverage();
+    };
 
-unsigned int loadTexture(char const * path) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    struct Resolution {
+        unsigned int width, height;
+        const char *name;
+    };
+    unsigned int brightFBO;
+    glGenFramebuffers(1, &brightFBO);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, brightFBO);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, brightTexture, 0);
+    PingPongBlur pingPongBlur(blurShader);
+    for (const Resolution &resolution : {Resolution{1920, 1080, "1080p"}, Resolution{3840, 2160, "4K"}}) {
+        unsigned int source, sourceFBO;
+        glGenTextures(1, &source);
+        glBindTexture(GL_TEXTURE_2D, source);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, resolution.width, resolution.height, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glGenFramebuffers(1, &sourceFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sourceFBO);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, brightFBO);
+        glBlitFramebuffer(0, 0, brightWidth, brightHeight, 0, 0, resolution.width, resolution.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        double fragmentTime, computeTime = 0.0;
+        fragmentTime = gpuMilliseconds([&]() {
+            pingPongBlur.Render(source, resolution.width, resolution.height, BLOOM_BLUR_ITERATIONS, renderQuad);
+        });
+        if (computeBlurShader) {
+            ComputeBlur blur(*computeBlurShader, resolution.width, resolution.height);
+            computeTime = gpuMilliseconds([&]() { blur.Render(source, BLOOM_BLUR_ITERATIONS); });
+        }
+        glDeleteFramebuffers(1, &sourceFBO);
+        glDeleteTextures(1, &source);
+
+        std::cout << "Blur " << resolution.name << " (radius " << bloomRadius << ", " << BLOOM_BLUR_ITERATIONS
+                  << " iterations): fragment " << fragmentTime << " ms";
+        if (computeBlurShader)
+            std::cout << ", compute " << computeTime << " ms";
+        else
+            std::cout << ", compute shaders need OpenGL 4.3";
+        std::cout << std::endl;
     }
-
-    return textureID;
+    glDeleteFramebuffers(1, &brightFBO);
 }